@@ -0,0 +1,294 @@
+/*
+ * bench_kernels.c
+ *
+ *  Microbenchmark of the kernels in nc2clm_kernels.h used by isimip_nc2clm_v2
+ *  Synthesizes one leap year of a global 0.5 degree field (360 x 720 x 366
+ *  floats, ~380 MB) and a grid of ncells land cells (default 67420 like the
+ *  LPJmL 0.5 degree grid) and times the naive gather against the blocked
+ *  gather for all cells. Both results are compared value by value.
+ *  Afterwards all conversion kernels supported by the CPU are timed on the
+ *  gathered values and checked to give results identical to the portable
+ *  kernel, also for values chosen to hit rounding, range and fill cases
+ *  Use: bench_kernels [ncells] [repetitions] [-shuffle] [-grid FILE]
+ *  -shuffle randomizes the order of cells instead of ordering them by
+ *  latitude and longitude like the LPJmL grid, -grid takes the cells and
+ *  their order from an LPJmL grid file of 0.5 degree resolution instead
+ *  (ncells is ignored), with latitudes of the field from north to south like
+ *  the ISIMIP input.
+ *  The gather chosen by isimip_nc2clm_v2 for the order of cells is printed
+ */
+/* compile e.g.:
+ * gcc -O3 bench_kernels.c -o bench_kernels -lm
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <limits.h>
+#include "nc2clm_kernels.h"
+
+#define NLAT 360
+#define NLON 720
+#define NDAYS 366
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/* small deterministic generator so runs are comparable */
+static unsigned int next_random(unsigned int *state) {
+	*state = *state*1103515245u + 12345u;
+	return (*state >> 8);
+}
+
+/* reads cells of LPJmL grid file as positions in the field, returns number of cells or -1 on error */
+static int read_gridcells(const char *path, size_t **nc_base) {
+	FILE *file;
+	char headername[7];
+	int header[7], ncell, cell, ilat, ilon, swapped;
+	float cellsize_scalar[2];
+	short *coord;
+	file = fopen(path, "rb");
+	if(file == NULL || fread(headername, 7, 1, file) != 1 || fread(header, sizeof(int), 7, file) != 7 ||
+	   fread(cellsize_scalar, sizeof(float), 2, file) != 2 || strncmp(headername, "LPJGRID", 7)) {
+		fprintf(stderr, "Error reading grid file %s\n", path);
+		if(file != NULL)
+			fclose(file);
+		return -1;
+	}
+	/* header: version, order, firstyear, nyear, firstcell, ncell, nband, cellsize, scalar */
+	swapped = header[0] < 1 || header[0] > 2;
+	ncell = swapped ? (int)__builtin_bswap32(header[5]) : header[5];
+	if(swapped) {
+		for(cell=0; cell<2; cell++) {
+			unsigned int n;
+			memcpy(&n, &cellsize_scalar[cell], sizeof(n));
+			n = __builtin_bswap32(n);
+			memcpy(&cellsize_scalar[cell], &n, sizeof(n));
+		}
+	}
+	if(ncell < 1 || ncell > NLAT*NLON || cellsize_scalar[0] != 0.5f) {
+		fprintf(stderr, "Error: %s is not a grid of 0.5 degree resolution\n", path);
+		fclose(file);
+		return -1;
+	}
+	coord = (short *)malloc(sizeof(short)*2*ncell);
+	*nc_base = (size_t *)malloc(sizeof(size_t)*ncell);
+	if(coord == NULL || *nc_base == NULL || fread(coord, sizeof(short), 2*ncell, file) != (size_t)2*ncell) {
+		fprintf(stderr, "Error reading grid file %s\n", path);
+		fclose(file);
+		return -1;
+	}
+	fclose(file);
+	for(cell=0; cell<ncell; cell++) {
+		if(swapped) {
+			coord[2*cell] = (short)__builtin_bswap16(coord[2*cell]);
+			coord[2*cell+1] = (short)__builtin_bswap16(coord[2*cell+1]);
+		}
+		/* lon and lat of cell centres, field from 89.75 N and 179.75 W */
+		ilon = (int)floor((coord[2*cell]*cellsize_scalar[1]+180)/0.5);
+		ilat = (int)floor((90-coord[2*cell+1]*cellsize_scalar[1])/0.5);
+		if(ilon < 0 || ilon >= NLON || ilat < 0 || ilat >= NLAT) {
+			fprintf(stderr, "Error: cell %d of %s out of range\n", cell, path);
+			return -1;
+		}
+		(*nc_base)[cell] = (size_t)ilat*NLON+ilon;
+	}
+	free(coord);
+	return ncell;
+} // of 'read_gridcells'
+
+/* converts all cells like convert_cells for short output, returns seconds of fastest run */
+static double bench_convert(const Kernels *k, const float *in, int ncells, int nrep, float *out, short *outshort, Kernelstats *st) {
+	int rep, cell;
+	double start, t, best = 1e30;
+	Kernelparam param;
+	init_kernelparam(&param, -273.15f, 10.0f, 1e20f);
+	for(rep=0; rep<nrep; rep++) {
+		st->nerror = 0;
+		st->min = SHRT_MAX;
+		st->max = SHRT_MIN;
+		start = now();
+		for(cell=0; cell<ncells; cell++)
+			k->convert[1][1](in+(size_t)cell*NDAYS, 365, &param, 1, out+(size_t)cell*365, outshort+(size_t)cell*365, st);
+		t = now()-start;
+		if(t < best)
+			best = t;
+	}
+	return best;
+}
+
+/* compares all variants of kernel k with the portable kernel on values hitting special cases, returns 0 if identical */
+static int check_kernel(const Kernels *k) {
+	static const float special[] = {0.0f, -0.0f, 0.5f, -0.5f, 1.5f, -2.5f, 0.49999997f, -0.49999997f, 3276.75f, 3276.85f, -3276.85f,
+		1e20f, 1e20f+1e14f, NAN, -NAN, INFINITY, -INFINITY, 8388609.0f, 1e10f, -1e10f, 214748.375f, 273.15f, 273.15f+1e-5f};
+	const Kernels *ref = select_kernels("scalar");
+	float in[997], out1[997], out2[997];
+	short short1[997], short2[997];
+	Kernelparam param;
+	Kernelstats st1, st2;
+	unsigned int state = 7;
+	int i, n, rep, finish, checkfill, shortout;
+	for(rep=0; rep<2000; rep++) {
+		n = 1 + next_random(&state) % 997;
+		for(i=0; i<n; i++)
+			in[i] = (next_random(&state) % 3) ? special[next_random(&state) % (sizeof(special)/sizeof(float))]
+			        : ((float)(next_random(&state) % 200000) - 100000.0f)/64.0f;
+		finish = next_random(&state) % 2;
+		checkfill = next_random(&state) % 2;
+		shortout = next_random(&state) % 2;
+		init_kernelparam(&param, (rep % 3) ? -273.15f : 0.0f, (rep % 5) ? 0.1f : 10.0f, 1e20f);
+		st1.nerror = st2.nerror = 0;
+		st1.min = st2.min = SHRT_MAX;
+		st1.max = st2.max = SHRT_MIN;
+		memset(short1, 0, sizeof(short1));
+		memset(short2, 0, sizeof(short2));
+		ref->convert[checkfill][shortout](in, n, &param, finish, out1, short1, &st1);
+		k->convert[checkfill][shortout](in, n, &param, finish, out2, short2, &st2);
+		if(!finish) {
+			ref->finish[shortout](out1, n, short1, &st1);
+			k->finish[shortout](out2, n, short2, &st2);
+		}
+		if(memcmp(out1, out2, sizeof(float)*n) || memcmp(short1, short2, sizeof(short)*n) || st1.nerror != st2.nerror ||
+		   memcmp(&st1.min, &st2.min, sizeof(float)) || memcmp(&st1.max, &st2.max, sizeof(float)))
+			return -1;
+	}
+	return 0;
+}
+
+/* gathers all cells in blocks of GATHER_CELLS like convert_cells, returns seconds of fastest run */
+static double bench(Gatherfunc gather, const float *nc_data, const size_t *nc_base, const size_t *nc_stride, int ncells, int nrep, float *out) {
+	int rep, block, nblock;
+	double start, t, best = 1e30;
+	for(rep=0; rep<nrep; rep++) {
+		start = now();
+		for(block=0; block<ncells; block+=GATHER_CELLS) {
+			nblock = (ncells-block < GATHER_CELLS) ? ncells-block : GATHER_CELLS;
+			gather(nc_data, nc_base, nc_stride, block, nblock, 0, NDAYS, out+(size_t)block*NDAYS, NDAYS);
+		}
+		t = now()-start;
+		if(t < best)
+			best = t;
+	}
+	return best;
+}
+
+int main(int argc, char *argv[]) {
+	int ncells = 67420, nrep = 5, shuffle = 0, arg, cell, i, tmp, *pos;
+	const char *gridpath = NULL;
+	unsigned int state = 42;
+	size_t n, *nc_base, *nc_stride;
+	float *nc_data, *out_naive, *out_blocked, *clm_ref;
+	short *short_ref, *clm_short;
+	double t_naive, t_blocked, t;
+	const Kernels *ref;
+	Kernelstats st_ref, st;
+
+	for(arg=1, i=0; arg<argc; arg++) {
+		if(strcmp(argv[arg], "-shuffle") == 0)
+			shuffle = 1;
+		else if(strcmp(argv[arg], "-grid") == 0 && arg+1 < argc)
+			gridpath = argv[++arg];
+		else if(i++ == 0)
+			ncells = atoi(argv[arg]);
+		else
+			nrep = atoi(argv[arg]);
+	}
+	if((gridpath == NULL && (ncells < 1 || ncells > NLAT*NLON)) || nrep < 1) {
+		fprintf(stderr, "Use: %s [ncells] [repetitions] [-shuffle] [-grid FILE]\n", argv[0]);
+		return -1;
+	}
+	if(gridpath != NULL) {
+		ncells = read_gridcells(gridpath, &nc_base);
+		if(ncells < 0)
+			return -1;
+	} else
+		nc_base = (size_t *)malloc(sizeof(size_t)*ncells);
+
+	nc_data = (float *)malloc(sizeof(float)*NDAYS*NLAT*NLON);
+	out_naive = (float *)malloc(sizeof(float)*NDAYS*ncells);
+	out_blocked = (float *)malloc(sizeof(float)*NDAYS*ncells);
+	nc_stride = (size_t *)malloc(sizeof(size_t)*ncells);
+	pos = (int *)malloc(sizeof(int)*NLAT*NLON);
+	if(nc_data == NULL || out_naive == NULL || out_blocked == NULL || nc_base == NULL || nc_stride == NULL || pos == NULL) {
+		fprintf(stderr, "Error allocating memory\n");
+		return -1;
+	}
+	for(n=0; n<(size_t)NDAYS*NLAT*NLON; n++)
+		nc_data[n] = (float)(n % 100003);
+
+	/* choose ncells random grid points, in field order unless shuffled */
+	for(i=0; i<NLAT*NLON; i++)
+		pos[i] = i;
+	for(i=0; i<ncells; i++) {
+		tmp = i + next_random(&state) % (NLAT*NLON-i);
+		cell = pos[i]; pos[i] = pos[tmp]; pos[tmp] = cell;
+	}
+	if(!shuffle) {
+		/* counting sort of chosen points */
+		char *chosen = (char *)calloc(NLAT*NLON, 1);
+		for(i=0; i<ncells; i++)
+			chosen[pos[i]] = 1;
+		for(i=0, cell=0; i<NLAT*NLON; i++)
+			if(chosen[i])
+				pos[cell++] = i;
+		free(chosen);
+	}
+	for(cell=0; cell<ncells; cell++) {
+		if(gridpath == NULL)
+			nc_base[cell] = pos[cell];
+		nc_stride[cell] = NLAT*NLON;
+	}
+
+	printf("cells: %d (%s order), days: %d, repetitions: %d, tile: %d cells x %d days\n", ncells, (gridpath != NULL) ? gridpath : shuffle ? "random" : "grid",
+	       NDAYS, nrep, GATHER_CELLS, GATHER_DAYS);
+	t_naive = bench(gather_naive, nc_data, nc_base, nc_stride, ncells, nrep, out_naive);
+	t_blocked = bench(gather_blocked, nc_data, nc_base, nc_stride, ncells, nrep, out_blocked);
+	if(memcmp(out_naive, out_blocked, sizeof(float)*NDAYS*ncells)) {
+		fprintf(stderr, "Error: results of naive and blocked gather differ\n");
+		return -1;
+	}
+	n = (size_t)NDAYS*ncells;
+	printf("naive gather:   %8.2f ms %8.1f Mvalues/s\n", t_naive*1e3, n/t_naive*1e-6);
+	printf("blocked gather: %8.2f ms %8.1f Mvalues/s\n", t_blocked*1e3, n/t_blocked*1e-6);
+	printf("speedup: %.2f, isimip_nc2clm_v2 uses %s gather\n", t_naive/t_blocked, (select_gather(nc_base, ncells) == gather_naive) ? "naive" : "blocked");
+
+	/* conversion kernels on a year of synthetic temperatures, reusing out_naive for results */
+	for(n=0; n<(size_t)NDAYS*ncells; n++)
+		out_blocked[n] = 250.0f + (float)(n % 997)*0.1f;
+	clm_ref = (float *)malloc(sizeof(float)*365*ncells);
+	short_ref = (short *)malloc(sizeof(short)*365*ncells);
+	clm_short = (short *)malloc(sizeof(short)*365*ncells);
+	if(clm_ref == NULL || short_ref == NULL || clm_short == NULL) {
+		fprintf(stderr, "Error allocating memory\n");
+		return -1;
+	}
+	ref = select_kernels("scalar");
+	t = bench_convert(ref, out_blocked, ncells, nrep, clm_ref, short_ref, &st_ref);
+	printf("%-8s convert: %8.2f ms %8.1f Mvalues/s\n", ref->name, t*1e3, 365.0*ncells/t*1e-6);
+	for(i=0; i<sizeof(kernels)/sizeof(kernels[0]); i++) {
+		if(&kernels[i] == ref || select_kernels(kernels[i].name) == NULL)
+			continue;
+		t = bench_convert(&kernels[i], out_blocked, ncells, nrep, out_naive, clm_short, &st);
+		if(memcmp(clm_ref, out_naive, sizeof(float)*365*ncells) || memcmp(short_ref, clm_short, sizeof(short)*365*ncells) ||
+		   st.nerror != st_ref.nerror || st.min != st_ref.min || st.max != st_ref.max || check_kernel(&kernels[i])) {
+			fprintf(stderr, "Error: results of %s and %s kernels differ\n", kernels[i].name, ref->name);
+			return -1;
+		}
+		printf("%-8s convert: %8.2f ms %8.1f Mvalues/s (identical)\n", kernels[i].name, t*1e3, 365.0*ncells/t*1e-6);
+	}
+	free(clm_ref);
+	free(short_ref);
+	free(clm_short);
+
+	free(nc_data);
+	free(out_naive);
+	free(out_blocked);
+	free(nc_base);
+	free(nc_stride);
+	free(pos);
+	return 0;
+}
@@ -0,0 +1,99 @@
+#!/bin/bash
+
+# Benchmark of isimip_nc2clm_v2 on synthetic data written by make_testdata.
+# Converts tas and pr with each set of options in cases, taking the time of
+# each stage from the -timing output of isimip_nc2clm_v2, and appends one
+# line per case and variable to a CSV file, so results can be compared
+# across commits.
+#
+# usage: bench_nc2clm.sh [-program PATH] [-testdata PATH] [-dir DIR] [-results FILE] [make_testdata options]
+# Test data is only written if DIR does not hold grid.bin yet; remove DIR to
+# write it again with other make_testdata options.
+
+
+# setup
+# *****
+program=./isimip_nc2clm_v2 # executable that converts NetCDF into CLM2
+testdata=./make_testdata # executable that writes synthetic NetCDF files and grid.bin
+directory=./bench_data # directory of test data and output
+results=bench_nc2clm.csv # CSV file results are appended to
+testdata_args=""
+
+# options of isimip_nc2clm_v2 compared; "" is the plain serial run
+cases=( "" "-threads 4" "-sparse" "-pipeline 3" "-pipeline 3 -threads 4" "-chunk 30" "-files 2" "-output direct" "-output mmap" )
+
+var_name=( "tas" "pr" )
+offset=( "-273.15" "0.0" )
+convert=( "10.0" "864000.0" )
+scale=( "0.1" "0.1" )
+leapday=( "drop" "redistribute" )
+
+while [ $# -gt 0 ]; do
+  case $1 in
+    -program) program=$2; shift 2 ;;
+    -testdata) testdata=$2; shift 2 ;;
+    -dir) directory=$2; shift 2 ;;
+    -results) results=$2; shift 2 ;;
+    *) testdata_args="$testdata_args $1"; shift ;;
+  esac
+done
+
+commit=` git -C $(dirname $0) rev-parse --short HEAD 2>/dev/null `
+if [ -z "$commit" ]; then
+  commit="unknown"
+fi
+
+
+# test data:
+# **********
+mkdir -p $directory
+if [ ! -f $directory/grid.bin ]; then
+  echo -e "  > writing test data to $directory"
+  $testdata $testdata_args $directory || exit 1
+fi
+ncells=` od -A n -t d4 -j 27 -N 4 $directory/grid.bin | tr -d ' ' `
+
+if [ ! -f $results ]; then
+  echo "commit,case,variable,cells,years,total_s,map_s,read_s,gather_s,convert_s,write_s,cells_days_per_s,read_MB_per_s,write_MB_per_s" > $results
+fi
+
+
+# run cases:
+# **********
+for c in ${!cases[@]}; do
+  name=${cases[$c]}
+  if [ -z "$name" ]; then
+    name="serial"
+  fi
+  for v in ${!var_name[@]}; do
+    infiles=( ` ls $directory/${var_name[$v]}_*_*.nc ` )
+    if [ ${#infiles[@]} -eq 0 ]; then
+      echo -e "  > Error: no test data for ${var_name[$v]} in $directory"
+      continue
+    fi
+    firstyearindex=` expr ${#infiles[0]} - 12 ` # filename ends on yyyy_yyyy.nc
+    firstyear=${infiles[0]:$firstyearindex:4}
+    outputfile=$directory/${var_name[$v]}.clm
+    rm -f $outputfile
+    time1=$(date +%s.%N)
+    $program ${#infiles[@]} ${infiles[@]} ${var_name[$v]} $firstyear $directory/grid.bin ${offset[$v]} ${convert[$v]} ${scale[$v]} $outputfile -leapday ${leapday[$v]} -timing ${cases[$c]} > $directory/bench.log 2>&1
+    status=$?
+    time2=$(date +%s.%N)
+    timing=` grep "\* timing:" $directory/bench.log | sed 's/.*timing: //' `
+    if [ $status -ne 0 ] || [ -z "$timing" ]; then
+      echo -e "  > Error: case '$name' failed for ${var_name[$v]}, see $directory/bench.log"
+      continue
+    fi
+    # timing holds key=value pairs
+    echo "$timing" | awk -v commit=$commit -v name="$name" -v var=${var_name[$v]} -v ncells=$ncells -v time1=$time1 -v time2=$time2 '{
+      total = time2-time1
+      for(i=1; i<=NF; i++) { split($i, kv, "="); t[kv[1]] = kv[2] }
+      printf "%s,%s,%s,%d,%d,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.0f,%.1f,%.1f\n", commit, name, var, ncells, t["values"]/(ncells*365), total,
+        t["map"], t["read"], t["gather"], t["convert"], t["write"], t["values"]/total,
+        (t["read"] > 0) ? t["read_bytes"]/t["read"]/1048576 : 0, (t["write"] > 0) ? t["write_bytes"]/t["write"]/1048576 : 0
+    }' | tee -a $results
+  done
+done
+rm -f $directory/*.clm
+
+# END
@@ -26,6 +26,8 @@ offset=(   "0.0"      "-273.15" "0.0"  "0.0"   "0.0"     "-273.15" "-273.15" "0.
 convert=(  "864000.0" "10.0"    "10.0" "10.0"  "100.0"   "10.0"    "10.0"    "1.0" )
 scale=(    "0.1"      "0.1"     "0.1"  "0.1"   "0.01"    "0.1"     "0.1"     "1.0" )
 flag=(     ""         ""        ""     ""      ""        ""        ""        "-float" ) # flag "-float" creates CLM version 3 with data type float
+leapday=(  "redistribute" "drop"  "drop" "drop"  "drop"    "drop"    "drop"    "drop" ) # handling of 29 February in leap years
+fuse_lwnet="TRUE" # compute lwnet from rlds and tas during conversion instead of using files from generate_lwnet_ISIMIP3B.sh
 
 gcm_index=( 0 1 2 3 4 )
 #gcm_index=0
@@ -75,7 +77,13 @@ for m in ${gcm_index[@]}; do
             echo ""
             time_sp1=$(date +%s)
             spinup_filename=""
-            if [ ${var_name[$v]} == "lwnet" ]
+            derive_args=""
+            if [ ${var_name[$v]} == "lwnet" ] && [ $fuse_lwnet == "TRUE" ]
+            then
+                spinup_filename=( `ls $directory_netcdf/picontrol/${gcm_path[$m]}/${gcm_spath[$m]}_${gcm_runs[$m]}_w5e5_picontrol_rlds_global_*.nc ` )
+                derive_filename=( `ls $directory_netcdf/picontrol/${gcm_path[$m]}/${gcm_spath[$m]}_${gcm_runs[$m]}_w5e5_picontrol_tas_global_*.nc ` )
+                derive_args="-derive lwnet tas ${derive_filename[@]}"
+            elif [ ${var_name[$v]} == "lwnet" ]
             then
                 spinup_filename=( `ls $directory_lwnet/lwnet/picontrol/${gcm_name[$m]}/lwnet_day_picontrol_${gcm_runs[$m]}*.nc ` )
             else
@@ -97,7 +105,7 @@ for m in ${gcm_index[@]}; do
                 else variable=${var_name[$v]}
                 fi
                 # create row of arguments to run the program (to create clm-files from NetCDF-data in workspace):
-                run_program=$program" "${#spinup_filename[@]}" "${spinup_filename[@]}" "$variable" "$sp_firstyear" "$gridpath" "${offset[$v]}" "${convert[$v]}" "${scale[$v]}" "$outputfile" "${flag[$v]}
+                run_program=$program" "${#spinup_filename[@]}" "${spinup_filename[@]}" "$variable" "$sp_firstyear" "$gridpath" "${offset[$v]}" "${convert[$v]}" "${scale[$v]}" "$outputfile" "${flag[$v]}" -leapday "${leapday[$v]}" "$derive_args
                 echo ""
                 echo "  > running program (with arguments as follows):"
                 echo "       $run_program"
@@ -123,7 +131,13 @@ for m in ${gcm_index[@]}; do
             echo ""
             # historical files:
             hist_filename=""
-            if [ ${var_name[$v]} == "lwnet" ]
+            derive_args=""
+            if [ ${var_name[$v]} == "lwnet" ] && [ $fuse_lwnet == "TRUE" ]
+            then
+                hist_filename=( `ls $directory_netcdf/historical/${gcm_path[$m]}/${gcm_spath[$m]}_${gcm_runs[$m]}_w5e5_historical_rlds_global_*.nc ` )
+                derive_filename=( `ls $directory_netcdf/historical/${gcm_path[$m]}/${gcm_spath[$m]}_${gcm_runs[$m]}_w5e5_historical_tas_global_*.nc ` )
+                derive_args="-derive lwnet tas ${derive_filename[@]}"
+            elif [ ${var_name[$v]} == "lwnet" ]
             then
                 hist_filename=( `ls $directory_lwnet/lwnet/historical/${gcm_name[$m]}/lwnet_day_historical_${gcm_runs[$m]}*.nc ` )
             else
@@ -145,7 +159,7 @@ for m in ${gcm_index[@]}; do
                 else variable=${var_name[$v]}
                 fi
                 # create row of arguments to run the program (to create clm-files from NetCDF-data in workspace):
-                run_program=$program" "${#hist_filename[@]}" "${hist_filename[@]}" "$variable" "$firstyear" "$gridpath" "${offset[$v]}" "${convert[$v]}" "${scale[$v]}" "$outputfile" "${flag[$v]}
+                run_program=$program" "${#hist_filename[@]}" "${hist_filename[@]}" "$variable" "$firstyear" "$gridpath" "${offset[$v]}" "${convert[$v]}" "${scale[$v]}" "$outputfile" "${flag[$v]}" -leapday "${leapday[$v]}" "$derive_args
                 echo ""
                 echo "  > running program (with arguments as follows):"
                 echo "       $run_program"
@@ -175,7 +189,13 @@ for m in ${gcm_index[@]}; do
             # scenario-files:
             for s in ${scen_index[@]}; do
                 time_sc1=$(date +%s)
-                if [ ${var_name[$v]} == "lwnet" ]
+                derive_args=""
+                if [ ${var_name[$v]} == "lwnet" ] && [ $fuse_lwnet == "TRUE" ]
+                then
+                    scen_filename=( `ls $directory_netcdf/${scen_name[$s]}/${gcm_path[$m]}/${gcm_spath[$m]}_${gcm_runs[$m]}_w5e5_${scen_name[$s]}_rlds_global_*.nc ` )
+                    derive_filename=( `ls $directory_netcdf/${scen_name[$s]}/${gcm_path[$m]}/${gcm_spath[$m]}_${gcm_runs[$m]}_w5e5_${scen_name[$s]}_tas_global_*.nc ` )
+                    derive_args="-derive lwnet tas ${derive_filename[@]}"
+                elif [ ${var_name[$v]} == "lwnet" ]
                 then
                     scen_filename=( `ls $directory_lwnet/lwnet/${scen_name[$s]}/${gcm_name[$m]}/lwnet_day_${scen_name[$s]}_${gcm_runs[$m]}*.nc ` )
                 else
@@ -207,7 +227,7 @@ for m in ${gcm_index[@]}; do
 
                 nc_number=${#scen_filename[@]}
                 # create row of arguments to run the program (to create clm-files from NetCDF-data in workspace):
-                run_program=$program" "$nc_number" "${complete_filestring[@]}" "$variable" "$firstyear" "$gridpath" "${offset[$v]}" "${convert[$v]}" "${scale[$v]}" "$outputfile" "${flag[$v]}
+                run_program=$program" "$nc_number" "${complete_filestring[@]}" "$variable" "$firstyear" "$gridpath" "${offset[$v]}" "${convert[$v]}" "${scale[$v]}" "$outputfile" "${flag[$v]}" -leapday "${leapday[$v]}" "$derive_args
                 echo ""
                 echo "       > running program (with arguments as follows):"
                 echo "       $run_program"
@@ -25,6 +25,8 @@ offset=( "0.0" "-273.15" "0.0" "0.0" "0.0" "-273.15" "-273.15" "0.0" )
 convert=( "864000.0" "10.0" "10.0" "10.0" "100.0" "10.0" "10.0" "1.0" )
 scale=( "0.1" "0.1" "0.1" "0.1" "0.01" "0.1" "0.1" "1.0" )
 flag=(   ""    ""     ""   ""     ""     ""    ""   "-float" ) # flag "-float" creates CLM version 3 with data type float
+leapday=( "redistribute" "drop" "drop" "drop" "drop" "drop" "drop" "drop" ) # handling of 29 February in leap years
+fuse_lwnet="TRUE" # compute lwnet from rlds and tas during conversion instead of using files from generate_lwnet_ISIMIP3a.sh
 
 # DSET_index=( 0 1 )
 DSET_index=( 0 )
@@ -57,7 +59,13 @@ for m in ${DSET_index[@]}; do
         echo -e "  > VARIABLE: ${var_name[$v]} (offset: ${offset[$v]}, convert: ${convert[$v]}, scale: ${scale[$v]})"
 
         time_sc1=$(date +%s)
-        if [ ${var_name[$v]} == "lwnet" ]
+        derive_args=""
+        if [ ${var_name[$v]} == "lwnet" ] && [ $fuse_lwnet == "TRUE" ]
+        then
+          scen_filename=( `ls $directory_netcdf/${scen_name[$s]}/global/daily/historical/${DSET_path[$m]}/${DSET_name[$m]}_${scen_name[$s]}_rlds_global_daily_*.nc ` )
+          derive_filename=( `ls $directory_netcdf/${scen_name[$s]}/global/daily/historical/${DSET_path[$m]}/${DSET_name[$m]}_${scen_name[$s]}_tas_global_daily_*.nc ` )
+          derive_args="-derive lwnet tas ${derive_filename[@]}"
+        elif [ ${var_name[$v]} == "lwnet" ]
         then
           scen_filename=( `ls ${directory_lwnet}/lwnet/${scen_name[$s]}/${DSET_path[$m]}/${DSET_name[$m]}_${scen_name[$s]}_${var_name[$v]}_global_daily_*.nc ` )
         else
@@ -92,7 +100,7 @@ for m in ${DSET_index[@]}; do
         fi
         nc_number=${#scen_filename[@]}
         # create row of arguments to run the program (to create clm-files from NetCDF-data in workspace):
-        run_program=$program" "$nc_number" "${complete_filestring[@]}" "$variable" "$firstyear" "$gridpath" "${offset[$v]}" "${convert[$v]}" "${scale[$v]}" "$outputfile" "${flag[$v]}
+        run_program=$program" "$nc_number" "${complete_filestring[@]}" "$variable" "$firstyear" "$gridpath" "${offset[$v]}" "${convert[$v]}" "${scale[$v]}" "$outputfile" "${flag[$v]}" -leapday "${leapday[$v]}" "$derive_args
         echo "       > running program (with arguments as follows):"
         echo "       $run_program"
         echo ""
@@ -0,0 +1,974 @@
+/*
+ * clmcheck.c
+ *
+ *  Checks CLM files written by isimip_nc2clm_v2 (CLM2 and CLM3 with
+ *  LPJ_SHORT or LPJ_FLOAT values, either byte order). Files are read through
+ *  a memory mapping one year after the other, so large files are read at
+ *  the bandwidth of the disk
+ *  Use: clmcheck stats [-cells FILE] clmfile
+ *         prints the header and min, max and mean of each year over all cells,
+ *         with -cells writes min, max and mean of each cell over all years to
+ *         FILE (CSV)
+ *       clmcheck diff [-tolerance X] clmfile1 clmfile2
+ *         compares headers and the values of the years in both files, e.g. the
+ *         output of two builds of isimip_nc2clm_v2; exit status is 0 if the
+ *         headers are equal and no values differ by more than X
+ *       clmcheck spot [-cells N] [-seed N] [-leapday drop|redistribute]
+ *                     [-firstyear N] clmfile path_to_gridfile var offset
+ *                     convert infilenames...
+ *         converts the values of N randomly sampled cells (default 100) of the
+ *         NetCDF files like isimip_nc2clm_v2 and compares them to clmfile;
+ *         exit status is 0 if all values match. The first NetCDF file starts
+ *         in the first year of clmfile unless -firstyear is given like for
+ *         isimip_nc2clm_v2, years before the first year of clmfile (written
+ *         with -startyear) are skipped. Quantized values are decoded with the
+ *         factors in the .factors.clm file next to clmfile. Derived variables
+ *         like lwnet cannot be checked
+ *  Values are printed times the scalar of the header. Minima, maxima and
+ *  sums of rows of values are computed with SSE2 where available
+ */
+/* compile e.g.:
+ * gcc -O2 clmcheck.c -o clmcheck -lnetcdf -lm
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <netcdf.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define is_equal(a, b) (fabs((a) - (b)) < 0.0001)
+#define LPJ_FLOAT 3
+#define LPJ_SHORT 1
+#define MAXDIFF 10 // differences printed
+
+typedef struct {
+	int version, order, firstyear, nyear, firstcell, ncell, nband;
+	float cellsize, scalar;
+} Header; // like in isimip_nc2clm_v2.c
+
+// ***** swap-functions *****
+static void swap(char *a,char *b){
+	char h;
+	h=*a;
+	*a=*b;
+	*b=h;
+}
+
+static short int swapshort(short int x){
+	swap((char *)&x,(char *)(&x)+1);
+	return x;
+}
+
+static int swapint(int x){
+	swap((char *)&x,(char *)(&x)+3);
+	swap((char *)&x+1,(char *)(&x)+2);
+	return x;
+}
+
+static float swapfloat(int num)
+{
+	float ret;
+	num=swapint(num);
+	memcpy(&ret,&num,sizeof(int));
+	return ret;
+} // of 'swapfloat'
+
+static double wallclock(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static int isleap(int year) {
+	return ((year%4 == 0) && (year%100 != 0)) || (year%400 == 0);
+}
+
+/* swaps header read from a file of the other byte order if version is not
+ * one of 1 to maxversion, returns 1 if swapped, -1 if byte order is unknown */
+static int swap_header(Header *header, int maxversion) {
+	int n;
+	if(header->version >= 1 && header->version <= maxversion)
+		return 0;
+	if(swapint(header->version) < 1 || swapint(header->version) > maxversion)
+		return -1;
+	header->version = swapint(header->version);
+	header->order = swapint(header->order);
+	header->firstyear = swapint(header->firstyear);
+	header->nyear = swapint(header->nyear);
+	header->firstcell = swapint(header->firstcell);
+	header->ncell = swapint(header->ncell);
+	header->nband = swapint(header->nband);
+	memcpy(&n, &header->cellsize, sizeof(int));
+	header->cellsize = swapfloat(n);
+	memcpy(&n, &header->scalar, sizeof(int));
+	header->scalar = swapfloat(n);
+	return 1;
+} // of 'swap_header'
+
+// ***** memory mapped CLM file *****
+typedef struct {
+	const char *path;
+	Header header;
+	int datatype; // LPJ_SHORT or LPJ_FLOAT
+	int swapped; // values are in the other byte order
+	size_t headersize, valuesize;
+	size_t yearsize; // bytes of one year of all cells
+	int nyear; // complete years in file
+	char *map;
+	size_t size;
+	double seconds; // time spent on values, to print throughput
+} Clmfile;
+
+/* maps CLM file path, returns 0 on success */
+static int open_clm(Clmfile *clm, const char *path) {
+	struct stat st;
+	int fd, datatype;
+	float cellsize;
+	clm->path = path;
+	clm->map = NULL;
+	clm->seconds = 0;
+	fd = open(path, O_RDONLY);
+	if(fd < 0 || fstat(fd, &st)) {
+		fprintf(stderr, "Error opening %s\n", path);
+		if(fd >= 0)
+			close(fd);
+		return -1;
+	}
+	clm->size = st.st_size;
+	if(clm->size < 7+sizeof(Header)) {
+		fprintf(stderr, "Error: %s is too short for a CLM file\n", path);
+		close(fd);
+		return -1;
+	}
+	clm->map = (char *)mmap(NULL, clm->size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(clm->map == MAP_FAILED) {
+		fprintf(stderr, "Error mapping %s\n", path);
+		clm->map = NULL;
+		return -1;
+	}
+	madvise(clm->map, clm->size, MADV_SEQUENTIAL);
+	if(strncmp(clm->map, "LPJCLIM", 7)) {
+		fprintf(stderr, "Error: %s is not a CLM file\n", path);
+		return -1;
+	}
+	memcpy(&clm->header, clm->map+7, sizeof(Header));
+	clm->swapped = swap_header(&clm->header, 3);
+	if(clm->swapped < 0) {
+		fprintf(stderr, "Error: cannot determine endian of %s\n", path);
+		return -1;
+	}
+	clm->headersize = 7+sizeof(Header);
+	clm->datatype = LPJ_SHORT;
+	if(clm->header.version == 3) {
+		if(clm->size < clm->headersize+sizeof(float)+sizeof(int)) {
+			fprintf(stderr, "Error: %s is too short for a CLM3 file\n", path);
+			return -1;
+		}
+		memcpy(&cellsize, clm->map+clm->headersize, sizeof(float));
+		memcpy(&datatype, clm->map+clm->headersize+sizeof(float), sizeof(int));
+		clm->datatype = clm->swapped ? swapint(datatype) : datatype;
+		clm->headersize += sizeof(float)+sizeof(int);
+	}
+	if(clm->datatype != LPJ_SHORT && clm->datatype != LPJ_FLOAT) {
+		fprintf(stderr, "Error: data type %d of %s not supported\n", clm->datatype, path);
+		return -1;
+	}
+	if(clm->header.ncell < 1 || clm->header.nband < 1 || clm->header.nyear < 0) {
+		fprintf(stderr, "Error: invalid header in %s\n", path);
+		return -1;
+	}
+	clm->valuesize = (clm->datatype == LPJ_FLOAT) ? sizeof(float) : sizeof(short);
+	clm->yearsize = (size_t)clm->header.ncell*clm->header.nband*clm->valuesize;
+	clm->nyear = (int)((clm->size-clm->headersize)/clm->yearsize);
+	if(clm->nyear < clm->header.nyear)
+		fprintf(stderr, "Warning: %s holds only %d of %d years\n", path, clm->nyear, clm->header.nyear);
+	else
+		clm->nyear = clm->header.nyear;
+	return 0;
+} // of 'open_clm'
+
+static void close_clm(Clmfile *clm) {
+	if(clm->map != NULL)
+		munmap(clm->map, clm->size);
+	clm->map = NULL;
+}
+
+/* returns values of year in the mapping, the pages of the previous year are released */
+static const char *clm_year(const Clmfile *clm, int year) {
+	long pagesize = sysconf(_SC_PAGESIZE);
+	size_t start, end;
+	if(year > 0) {
+		/* keeps resident memory small for files larger than RAM */
+		start = (clm->headersize+(year-1)*clm->yearsize)/pagesize*pagesize;
+		end = (clm->headersize+year*clm->yearsize)/pagesize*pagesize;
+		if(end > start)
+			madvise(clm->map+start, end-start, MADV_DONTNEED);
+	}
+	if(year+1 < clm->nyear)
+		madvise(clm->map+(clm->headersize+(year+1)*clm->yearsize)/pagesize*pagesize, clm->yearsize, MADV_WILLNEED);
+	return clm->map+clm->headersize+year*clm->yearsize;
+} // of 'clm_year'
+
+/* value number i of data, not multiplied with scalar */
+static double clm_value(const Clmfile *clm, const char *data, size_t i) {
+	short s;
+	float f;
+	int n;
+	if(clm->datatype == LPJ_FLOAT) {
+		memcpy(&n, data+i*sizeof(float), sizeof(float));
+		if(clm->swapped)
+			return swapfloat(n);
+		memcpy(&f, &n, sizeof(float));
+		return f;
+	}
+	memcpy(&s, data+i*sizeof(short), sizeof(short));
+	return clm->swapped ? swapshort(s) : s;
+} // of 'clm_value'
+
+static void print_header(const Clmfile *clm) {
+	fprintf(stdout, "%s: version %d, order %d, firstyear %d, nyear %d (%d in file), firstcell %d, ncell %d, nband %d, cellsize %g, scalar %g, %s%s\n",
+		clm->path, clm->header.version, clm->header.order, clm->header.firstyear, clm->header.nyear, clm->nyear, clm->header.firstcell,
+		clm->header.ncell, clm->header.nband, clm->header.cellsize, clm->header.scalar, (clm->datatype == LPJ_FLOAT) ? "float" : "short",
+		clm->swapped ? ", swapped" : "");
+}
+
+static void print_throughput(const Clmfile *clm, int nyear) {
+	double mb = (double)nyear*clm->yearsize/(1024*1024);
+	if(clm->seconds > 0)
+		fprintf(stdout, "read %.1f MB of %s in %.2f s (%.1f MB/s)\n", mb, clm->path, clm->seconds, mb/clm->seconds);
+}
+
+// ***** reductions of rows of values *****
+typedef struct {
+	double sum;
+	float min, max;
+	long long n; // values summed
+	long long nnan; // NaN in float files, not part of min, max and sum
+} Reduction;
+
+static void init_reduction(Reduction *r) {
+	r->sum = 0;
+	r->min = INFINITY;
+	r->max = -INFINITY;
+	r->n = r->nnan = 0;
+}
+
+static void add_reduction(Reduction *r, const Reduction *part) {
+	r->sum += part->sum;
+	if(part->min < r->min)
+		r->min = part->min;
+	if(part->max > r->max)
+		r->max = part->max;
+	r->n += part->n;
+	r->nnan += part->nnan;
+}
+
+static void reduce_short(const short *values, int n, Reduction *r) {
+	int i = 0, min = SHRT_MAX, max = SHRT_MIN;
+	long long sum = 0;
+#if defined(__SSE2__)
+	short lanes[8];
+	int sums[4], k;
+	__m128i x, vmin = _mm_set1_epi16(SHRT_MAX), vmax = _mm_set1_epi16(SHRT_MIN), vsum;
+	const __m128i one = _mm_set1_epi16(1);
+	while(i+8 <= n) {
+		/* 32 bit sums of pairs cannot overflow within 16384 blocks of 8 values */
+		vsum = _mm_setzero_si128();
+		for(k=0; k<16384 && i+8<=n; k++, i+=8) {
+			x = _mm_loadu_si128((const __m128i *)(values+i));
+			vmin = _mm_min_epi16(vmin, x);
+			vmax = _mm_max_epi16(vmax, x);
+			vsum = _mm_add_epi32(vsum, _mm_madd_epi16(x, one));
+		}
+		_mm_storeu_si128((__m128i *)sums, vsum);
+		sum += (long long)sums[0]+sums[1]+sums[2]+sums[3];
+	}
+	_mm_storeu_si128((__m128i *)lanes, vmin);
+	for(k=0; k<8; k++)
+		if(lanes[k] < min)
+			min = lanes[k];
+	_mm_storeu_si128((__m128i *)lanes, vmax);
+	for(k=0; k<8; k++)
+		if(lanes[k] > max)
+			max = lanes[k];
+#endif
+	for(; i<n; i++) {
+		if(values[i] < min)
+			min = values[i];
+		if(values[i] > max)
+			max = values[i];
+		sum += values[i];
+	}
+	r->sum += (double)sum;
+	if(min < r->min)
+		r->min = min;
+	if(max > r->max)
+		r->max = max;
+	r->n += n;
+} // of 'reduce_short'
+
+static void reduce_float(const float *values, int n, Reduction *r) {
+	int i = 0, nnan = 0;
+	float min = INFINITY, max = -INFINITY;
+	double sum = 0;
+#if defined(__SSE2__)
+	float lanes[4];
+	double sums[2];
+	int k;
+	__m128 x, ordered, vmin = _mm_set1_ps(INFINITY), vmax = _mm_set1_ps(-INFINITY);
+	__m128d vsum = _mm_setzero_pd();
+	for(; i+4<=n; i+=4) {
+		x = _mm_loadu_ps(values+i);
+		/* min and max return the second operand if one is NaN */
+		vmin = _mm_min_ps(x, vmin);
+		vmax = _mm_max_ps(x, vmax);
+		ordered = _mm_cmpord_ps(x, x);
+		nnan += 4-__builtin_popcount(_mm_movemask_ps(ordered));
+		x = _mm_and_ps(x, ordered);
+		vsum = _mm_add_pd(vsum, _mm_cvtps_pd(x));
+		vsum = _mm_add_pd(vsum, _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+	}
+	_mm_storeu_ps(lanes, vmin);
+	for(k=0; k<4; k++)
+		if(lanes[k] < min)
+			min = lanes[k];
+	_mm_storeu_ps(lanes, vmax);
+	for(k=0; k<4; k++)
+		if(lanes[k] > max)
+			max = lanes[k];
+	_mm_storeu_pd(sums, vsum);
+	sum = sums[0]+sums[1];
+#endif
+	for(; i<n; i++) {
+		if(isnan(values[i])) {
+			nnan++;
+			continue;
+		}
+		if(values[i] < min)
+			min = values[i];
+		if(values[i] > max)
+			max = values[i];
+		sum += values[i];
+	}
+	r->sum += sum;
+	if(min < r->min)
+		r->min = min;
+	if(max > r->max)
+		r->max = max;
+	r->n += n-nnan;
+	r->nnan += nnan;
+} // of 'reduce_float'
+
+/* reduces row of n values of clm, tmp holds n values for swapped files */
+static void reduce_row(const Clmfile *clm, const char *row, int n, void *tmp, Reduction *r) {
+	int i, k;
+	if(clm->swapped) {
+		if(clm->datatype == LPJ_FLOAT)
+			for(i=0; i<n; i++) {
+				memcpy(&k, row+i*sizeof(float), sizeof(int));
+				((float *)tmp)[i] = swapfloat(k);
+			}
+		else
+			for(i=0; i<n; i++)
+				((short *)tmp)[i] = swapshort(((const short *)row)[i]);
+		row = (const char *)tmp;
+	}
+	if(clm->datatype == LPJ_FLOAT)
+		reduce_float((const float *)row, n, r);
+	else
+		reduce_short((const short *)row, n, r);
+} // of 'reduce_row'
+
+static void print_reduction(FILE *file, const char *label, const Reduction *r, float scalar) {
+	if(r->n == 0)
+		fprintf(file, "%s,,,", label);
+	else
+		fprintf(file, "%s,%g,%g,%g", label, r->min*scalar, r->max*scalar, r->sum/r->n*scalar);
+	if(r->nnan)
+		fprintf(file, ",%lld NaN", r->nnan);
+	fprintf(file, "\n");
+}
+
+// ***** stats *****
+static int stats(const char *path, const char *cellpath) {
+	Clmfile clm;
+	Reduction *cells = NULL, row, year_r, all;
+	void *tmp;
+	const char *data;
+	char label[32];
+	int year, cell, nband;
+	FILE *cellfile = NULL;
+	double start;
+
+	if(open_clm(&clm, path)) {
+		close_clm(&clm);
+		return -1;
+	}
+	print_header(&clm);
+	nband = clm.header.nband;
+	tmp = malloc(clm.valuesize*nband);
+	if(cellpath != NULL) {
+		cells = (Reduction *)malloc(sizeof(Reduction)*clm.header.ncell);
+		cellfile = fopen(cellpath, "w");
+		if(cells == NULL || cellfile == NULL) {
+			fprintf(stderr, "Error creating %s\n", cellpath);
+			free(cells);
+			free(tmp);
+			close_clm(&clm);
+			return -1;
+		}
+		for(cell=0; cell<clm.header.ncell; cell++)
+			init_reduction(cells+cell);
+	}
+	if(tmp == NULL) {
+		fprintf(stderr, "Error allocating memory for values\n");
+		close_clm(&clm);
+		return -1;
+	}
+	init_reduction(&all);
+	fprintf(stdout, "year,min,max,mean\n");
+	for(year=0; year<clm.nyear; year++) {
+		start = wallclock();
+		data = clm_year(&clm, year);
+		init_reduction(&year_r);
+		for(cell=0; cell<clm.header.ncell; cell++) {
+			init_reduction(&row);
+			reduce_row(&clm, data+(size_t)cell*nband*clm.valuesize, nband, tmp, &row);
+			add_reduction(&year_r, &row);
+			if(cells != NULL)
+				add_reduction(cells+cell, &row);
+		}
+		clm.seconds += wallclock()-start;
+		add_reduction(&all, &year_r);
+		snprintf(label, sizeof(label), "%d", clm.header.firstyear+year);
+		print_reduction(stdout, label, &year_r, clm.header.scalar);
+	}
+	print_reduction(stdout, "all", &all, clm.header.scalar);
+	if(cellfile != NULL) {
+		fprintf(cellfile, "cell,min,max,mean\n");
+		for(cell=0; cell<clm.header.ncell; cell++) {
+			snprintf(label, sizeof(label), "%d", clm.header.firstcell+cell);
+			print_reduction(cellfile, label, cells+cell, clm.header.scalar);
+		}
+		if(fclose(cellfile))
+			fprintf(stderr, "Error writing %s\n", cellpath);
+	}
+	print_throughput(&clm, clm.nyear);
+	free(cells);
+	free(tmp);
+	close_clm(&clm);
+	return 0;
+} // of 'stats'
+
+// ***** diff *****
+static int diff(const char *path1, const char *path2, double tolerance) {
+	Clmfile clm1, clm2;
+	const char *data1, *data2;
+	int year, year1, year2, firstyear, lastyear, bytewise, different = 0;
+	size_t block, i, n, nvalue, maxi = 0;
+	long long ndiff = 0, ntolerated = 0, nvalues = 0;
+	double value1, value2, d, maxdiff = 0, start;
+	int maxyear = 0;
+
+	clm1.map = clm2.map = NULL;
+	if(open_clm(&clm1, path1) || open_clm(&clm2, path2)) {
+		close_clm(&clm1);
+		close_clm(&clm2);
+		return -1;
+	}
+	print_header(&clm1);
+	print_header(&clm2);
+#define COMPARE(field) if(clm1.header.field != clm2.header.field) { fprintf(stdout, "header differs in " #field "\n"); different = 1; }
+	COMPARE(version)
+	COMPARE(order)
+	COMPARE(firstyear)
+	COMPARE(nyear)
+	COMPARE(firstcell)
+	COMPARE(ncell)
+	COMPARE(nband)
+	COMPARE(cellsize)
+	COMPARE(scalar)
+#undef COMPARE
+	if(clm1.datatype != clm2.datatype) {
+		fprintf(stdout, "data type differs\n");
+		different = 1;
+	}
+	if(clm1.header.ncell != clm2.header.ncell || clm1.header.nband != clm2.header.nband) {
+		fprintf(stdout, "values not compared\n");
+		close_clm(&clm1);
+		close_clm(&clm2);
+		return 1;
+	}
+	/* years in both files */
+	firstyear = (clm1.header.firstyear > clm2.header.firstyear) ? clm1.header.firstyear : clm2.header.firstyear;
+	lastyear = (clm1.header.firstyear+clm1.nyear < clm2.header.firstyear+clm2.nyear) ? clm1.header.firstyear+clm1.nyear-1 : clm2.header.firstyear+clm2.nyear-1;
+	nvalue = (size_t)clm1.header.ncell*clm1.header.nband;
+	/* files of the same type and scalar are compared bytewise first */
+	bytewise = clm1.datatype == clm2.datatype && clm1.swapped == clm2.swapped && clm1.header.scalar == clm2.header.scalar;
+	for(year=firstyear; year<=lastyear; year++) {
+		start = wallclock();
+		year1 = year-clm1.header.firstyear;
+		year2 = year-clm2.header.firstyear;
+		data1 = clm_year(&clm1, year1);
+		data2 = clm_year(&clm2, year2);
+		nvalues += nvalue;
+		if(bytewise && !memcmp(data1, data2, clm1.yearsize)) {
+			clm1.seconds += wallclock()-start;
+			continue;
+		}
+		for(block=0; block<nvalue; block+=n) {
+			/* skip equal blocks of 1024 values */
+			n = (nvalue-block < 1024) ? nvalue-block : 1024;
+			if(bytewise && !memcmp(data1+block*clm1.valuesize, data2+block*clm2.valuesize, n*clm1.valuesize))
+				continue;
+			for(i=block; i<block+n; i++) {
+				value1 = clm_value(&clm1, data1, i)*clm1.header.scalar;
+				value2 = clm_value(&clm2, data2, i)*clm2.header.scalar;
+				if(value1 == value2 || (isnan(value1) && isnan(value2)))
+					continue;
+				d = isnan(value1) || isnan(value2) ? INFINITY : fabs(value1-value2);
+				if(d <= tolerance) {
+					ntolerated++;
+					continue;
+				}
+				if(ndiff < MAXDIFF)
+					fprintf(stdout, "year %d, cell %d, band %d: %g %g\n", year, clm1.header.firstcell+(int)(i/clm1.header.nband), (int)(i%clm1.header.nband), value1, value2);
+				ndiff++;
+				if(d > maxdiff) {
+					maxdiff = d;
+					maxyear = year;
+					maxi = i;
+				}
+			}
+		}
+		clm1.seconds += wallclock()-start;
+	}
+	if(lastyear < firstyear)
+		fprintf(stdout, "no common years\n");
+	else
+		fprintf(stdout, "compared %lld values of years %d-%d\n", nvalues, firstyear, lastyear);
+	if(ntolerated)
+		fprintf(stdout, "%lld values differ by at most %g\n", ntolerated, tolerance);
+	if(ndiff) {
+		fprintf(stdout, "%lld values differ, largest difference %g in year %d, cell %d, band %d\n", ndiff, maxdiff, maxyear,
+			clm1.header.firstcell+(int)(maxi/clm1.header.nband), (int)(maxi%clm1.header.nband));
+		different = 1;
+	} else if(!different)
+		fprintf(stdout, "files are equal\n");
+	print_throughput(&clm1, lastyear-firstyear+1);
+	close_clm(&clm1);
+	close_clm(&clm2);
+	return different;
+} // of 'diff'
+
+// ***** spot check against NetCDF *****
+#define LEAPDAY_DROP 0
+#define LEAPDAY_REDISTRIBUTE 1
+
+typedef struct {
+	Header header;
+	short *data; // lon and lat of each cell
+} Grid;
+
+/* reads grid file, returns 0 on success */
+static int read_grid(Grid *grid, const char *path) {
+	FILE *file;
+	char headername[7];
+	int swapped, cell;
+	grid->data = NULL;
+	file = fopen(path, "rb");
+	if(file == NULL) {
+		fprintf(stderr, "Error opening grid file %s\n", path);
+		return -1;
+	}
+	if(fread(headername, 7, 1, file) != 1 || fread(&grid->header, sizeof(Header), 1, file) != 1 || strncmp(headername, "LPJGRID", 7)) {
+		fprintf(stderr, "Error: %s is not a grid file\n", path);
+		fclose(file);
+		return -1;
+	}
+	swapped = swap_header(&grid->header, 2);
+	if(swapped < 0 || grid->header.ncell < 1) {
+		fprintf(stderr, "Error: cannot determine endian of grid file %s\n", path);
+		fclose(file);
+		return -1;
+	}
+	grid->data = (short *)malloc(sizeof(short)*grid->header.ncell*2);
+	if(grid->data == NULL || fread(grid->data, sizeof(short), grid->header.ncell*2, file) != (size_t)grid->header.ncell*2) {
+		fprintf(stderr, "Error reading grid file %s\n", path);
+		fclose(file);
+		return -1;
+	}
+	fclose(file);
+	if(swapped)
+		for(cell=0; cell<grid->header.ncell*2; cell++)
+			grid->data[cell] = swapshort(grid->data[cell]);
+	return 0;
+} // of 'read_grid'
+
+/* index of coordinate like isimip_nc2clm_v2, the last of several matching ones, -1 if not found */
+static int find_index(const double *coord, size_t len, double value) {
+	int i;
+	for(i=(int)len-1; i>=0; i--)
+		if(is_equal(value, coord[i]))
+			return i;
+	return -1;
+}
+
+/* reads coordinate variable name of length *len of ncid, returns NULL on error */
+static double *read_coord(int ncid, const char *name, size_t *len) {
+	int dim_id, var_id;
+	double *coord;
+	if(nc_inq_dimid(ncid, name, &dim_id) != NC_NOERR || nc_inq_dimlen(ncid, dim_id, len) != NC_NOERR ||
+	   nc_inq_varid(ncid, name, &var_id) != NC_NOERR)
+		return NULL;
+	coord = (double *)malloc(sizeof(double)*(*len));
+	if(coord != NULL && nc_get_var_double(ncid, var_id, coord) != NC_NOERR) {
+		free(coord);
+		return NULL;
+	}
+	return coord;
+} // of 'read_coord'
+
+/* converts the 365 or 366 values of one year of a cell like the conversion
+ * kernels of isimip_nc2clm_v2, valid is cleared for fill values, NaN and
+ * values out of the range of short and set to 2 for days with the leap day
+ * added, which may be rounded differently if the sum is contracted */
+static void convert_year(const float *values, int leap_yr, int leapday, float fill_value, float offset, float convert, int datatype, float *clm, char *valid) {
+	int day, febday, in;
+	for(day=0; day<365; day++) {
+		/* day 59 is 29 February in leap years */
+		in = (leap_yr && day >= 59) ? day+1 : day;
+		clm[day] = (values[in] + offset)*convert;
+		valid[day] = !is_equal(values[in], fill_value) && !isnan(values[in]) &&
+			(datatype == LPJ_FLOAT || (clm[day] >= SHRT_MIN && clm[day] <= SHRT_MAX));
+	}
+	if(leap_yr && leapday == LEAPDAY_REDISTRIBUTE && !is_equal(values[59], fill_value)) {
+		for(febday=31; febday<59; febday++) {
+			clm[febday] += (values[59]/28+offset)*convert;
+			if(valid[febday])
+				valid[febday] = 2;
+			if(isnan(values[59]) || (datatype != LPJ_FLOAT && (clm[febday] < SHRT_MIN || clm[febday] > SHRT_MAX)))
+				valid[febday] = 0;
+		}
+	}
+} // of 'convert_year'
+
+static int compare_cells(const int *a, const int *b) {
+	return *a-*b;
+}
+
+/* maps file of quantization factors next to clm if there is one, returns 1
+ * if mapped, 0 if there is none and -1 on error */
+static int open_factors(Clmfile *factors, const Clmfile *clm) {
+	static char path[4096];
+	size_t len = strlen(clm->path);
+	factors->map = NULL;
+	if(len > 4 && strcmp(clm->path+len-4, ".clm") == 0)
+		len -= 4;
+	snprintf(path, sizeof(path), "%.*s.factors.clm", (int)len, clm->path);
+	if(access(path, F_OK))
+		return 0;
+	if(open_clm(factors, path))
+		return -1;
+	if(clm->datatype != LPJ_SHORT || factors->datatype != LPJ_FLOAT || factors->header.nband != 2 ||
+	   factors->header.firstyear != clm->header.firstyear || factors->nyear < clm->nyear ||
+	   (factors->header.ncell != clm->header.ncell && factors->header.ncell != 1)) {
+		fprintf(stderr, "Error: quantization factors %s do not match %s\n", path, clm->path);
+		return -1;
+	}
+	fprintf(stdout, "quantized values decoded with factors of %s\n", factors->header.ncell == 1 ? "each year" : "each cell and year");
+	return 1;
+} // of 'open_factors'
+
+static int spot(const char *path, const char *gridpath, const char *var, float offset, float convert,
+                int nfiles, char **infiles, int ncheck, unsigned int seed, int leapday, int firstyear) {
+	Clmfile clm, factors;
+	Grid grid;
+	int *cells = NULL, *ilat = NULL, *ilon = NULL;
+	int i, k, cell, file, ncid, var_id, yr, year, fileyear, first, last, nyr, day, status, quantized, result = 0;
+	size_t latlen, lonlen, time_len = 0, start[3], count[3], firstday, skipdays;
+	double *nclat, *nclon, expected, value, d, tolerance, maxdiff = 0, lon, lat, qoffset = 0, qscale = 0;
+	float fill_value, *values = NULL, clm_values[365];
+	char valid[365];
+	long long nchecked = 0, nskipped = 0, nmismatch = 0;
+	const char *data;
+
+	grid.data = NULL;
+	factors.map = NULL;
+	if(open_clm(&clm, path) || read_grid(&grid, gridpath)) {
+		close_clm(&clm);
+		free(grid.data);
+		return -1;
+	}
+	print_header(&clm);
+	if(firstyear == INT_MIN)
+		firstyear = clm.header.firstyear;
+	quantized = open_factors(&factors, &clm);
+	if(quantized < 0) {
+		close_clm(&factors);
+		close_clm(&clm);
+		free(grid.data);
+		return -1;
+	}
+	if(firstyear > clm.header.firstyear)
+		fprintf(stdout, "first %d years of %s not checked, input files start in %d\n", firstyear-clm.header.firstyear, path, firstyear);
+	if(clm.header.nband != 365) {
+		fprintf(stderr, "Error: %s holds %d instead of 365 values per year\n", path, clm.header.nband);
+		close_clm(&factors);
+		close_clm(&clm);
+		free(grid.data);
+		return -1;
+	}
+	if(clm.header.firstcell+clm.header.ncell > grid.header.ncell) {
+		fprintf(stderr, "Error: %s holds more cells than grid file %s\n", path, gridpath);
+		close_clm(&factors);
+		close_clm(&clm);
+		free(grid.data);
+		return -1;
+	}
+	/* sample of ncheck cells, partial Fisher-Yates shuffle */
+	if(ncheck > clm.header.ncell)
+		ncheck = clm.header.ncell;
+	cells = (int *)malloc(sizeof(int)*clm.header.ncell);
+	ilat = (int *)malloc(sizeof(int)*ncheck);
+	ilon = (int *)malloc(sizeof(int)*ncheck);
+	if(cells == NULL || ilat == NULL || ilon == NULL) {
+		fprintf(stderr, "Error allocating memory for cells\n");
+		free(cells);
+		free(ilat);
+		free(ilon);
+		close_clm(&factors);
+		close_clm(&clm);
+		free(grid.data);
+		return -1;
+	}
+	for(cell=0; cell<clm.header.ncell; cell++)
+		cells[cell] = cell;
+	for(i=0; i<ncheck; i++) {
+		k = i+(int)(rand_r(&seed)%(unsigned int)(clm.header.ncell-i));
+		cell = cells[i];
+		cells[i] = cells[k];
+		cells[k] = cell;
+	}
+	qsort(cells, ncheck, sizeof(int), (int (*)(const void *, const void *))compare_cells);
+	fprintf(stdout, "checking %d cells\n", ncheck);
+
+	for(file=0, fileyear=firstyear; file<nfiles && fileyear<clm.header.firstyear+clm.nyear; file++, fileyear+=nyr) {
+		status = nc_open(infiles[file], NC_NOWRITE, &ncid);
+		if(status != NC_NOERR) {
+			fprintf(stderr, "Error opening %s: %s\n", infiles[file], nc_strerror(status));
+			result = -1;
+			break;
+		}
+		nclat = read_coord(ncid, "lat", &latlen);
+		nclon = read_coord(ncid, "lon", &lonlen);
+		status = nc_inq_varid(ncid, var, &var_id);
+		if(status == NC_NOERR && nc_get_att_float(ncid, var_id, "_FillValue", &fill_value) != NC_NOERR)
+			status = nc_get_att_float(ncid, var_id, "missing_value", &fill_value);
+		if(status == NC_NOERR)
+			status = nc_inq_dimid(ncid, "time", &k);
+		if(status == NC_NOERR)
+			status = nc_inq_dimlen(ncid, k, &time_len);
+		if(status != NC_NOERR || nclat == NULL || nclon == NULL) {
+			fprintf(stderr, "Error reading variable %s, fill value or coordinates of %s\n", var, infiles[file]);
+			free(nclat);
+			free(nclon);
+			nc_close(ncid);
+			result = -1;
+			break;
+		}
+		values = (float *)realloc(values, sizeof(float)*time_len);
+		nyr = (int)(time_len/365);
+		if(values == NULL) {
+			fprintf(stderr, "Error allocating memory for values\n");
+			free(nclat);
+			free(nclon);
+			nc_close(ncid);
+			result = -1;
+			break;
+		}
+		/* years of file in CLM file */
+		first = (fileyear < clm.header.firstyear) ? clm.header.firstyear-fileyear : 0;
+		last = (fileyear+nyr < clm.header.firstyear+clm.nyear) ? nyr : clm.header.firstyear+clm.nyear-fileyear;
+		for(yr=0, skipdays=0; yr<first; yr++)
+			skipdays += 365+isleap(fileyear+yr);
+		if(first >= last || skipdays >= time_len) {
+			fprintf(stdout, "%s: years %d-%d before first year %d of %s\n", infiles[file], fileyear, fileyear+nyr-1, clm.header.firstyear, path);
+			free(nclat);
+			free(nclon);
+			nc_close(ncid);
+			continue;
+		}
+		for(i=0; i<ncheck; i++) {
+			lon = grid.data[(clm.header.firstcell+cells[i])*2]*grid.header.scalar;
+			lat = grid.data[(clm.header.firstcell+cells[i])*2+1]*grid.header.scalar;
+			ilon[i] = find_index(nclon, lonlen, lon);
+			ilat[i] = find_index(nclat, latlen, lat);
+			if(ilon[i] < 0 || ilat[i] < 0) {
+				fprintf(stdout, "cell %d (%.2f°, %.2f°) not found in %s\n", clm.header.firstcell+cells[i], lon, lat, infiles[file]);
+				result = 1;
+				continue;
+			}
+			/* time series of the cell from first year in CLM file */
+			start[0] = skipdays;
+			start[1] = ilat[i];
+			start[2] = ilon[i];
+			count[0] = time_len-skipdays;
+			count[1] = count[2] = 1;
+			status = nc_get_vara_float(ncid, var_id, start, count, values);
+			if(status != NC_NOERR) {
+				fprintf(stderr, "Error reading %s: %s\n", infiles[file], nc_strerror(status));
+				result = -1;
+				break;
+			}
+			for(yr=first, firstday=0; yr<last; yr++) {
+				k = isleap(fileyear+yr);
+				if(skipdays+firstday+365+k > time_len)
+					break;
+				/* values of quantized files are written like with -float */
+				convert_year(values+firstday, k, leapday, fill_value, offset, convert, quantized ? LPJ_FLOAT : clm.datatype, clm_values, valid);
+				firstday += 365+k;
+				year = fileyear+yr-clm.header.firstyear;
+				data = clm.map+clm.headersize+year*clm.yearsize+(size_t)cells[i]*365*clm.valuesize;
+				if(quantized) {
+					data = factors.map+factors.headersize+year*factors.yearsize;
+					qoffset = clm_value(&factors, data, (factors.header.ncell == 1) ? 0 : (size_t)cells[i]*2);
+					qscale = clm_value(&factors, data, (factors.header.ncell == 1) ? 1 : (size_t)cells[i]*2+1);
+					data = clm.map+clm.headersize+year*clm.yearsize+(size_t)cells[i]*365*clm.valuesize;
+				}
+				for(day=0; day<365; day++) {
+					if(!valid[day]) {
+						nskipped++;
+						continue;
+					}
+					nchecked++;
+					value = clm_value(&clm, data, day);
+					if(quantized) {
+						/* missing values are stored as SHRT_MIN, the error of others is at most half the scale
+						 * and the rounding of the float offset */
+						value = (value == SHRT_MIN) ? NAN : qoffset+value*qscale;
+						expected = clm_values[day];
+						tolerance = 0.5*qscale+1e-6*(fabs(qoffset)+fabs(expected));
+					} else {
+						expected = (clm.datatype == LPJ_FLOAT) ? clm_values[day] : roundf(clm_values[day]);
+						tolerance = (clm.datatype == LPJ_FLOAT) ? 1e-6*fabs(expected) : valid[day]-1;
+					}
+					d = fabs(value-expected);
+					if(isnan(d) || d > tolerance) {
+						if(nmismatch < MAXDIFF)
+							fprintf(stdout, "year %d, cell %d, day %d: %g expected %g\n", fileyear+yr, clm.header.firstcell+cells[i], day,
+								value*clm.header.scalar, expected*clm.header.scalar);
+						nmismatch++;
+					}
+					if(d > maxdiff)
+						maxdiff = d;
+				}
+			}
+		}
+		fprintf(stdout, "%s: years %d-%d\n", infiles[file], fileyear+first, fileyear+last-1);
+		free(nclat);
+		free(nclon);
+		nc_close(ncid);
+		if(result < 0)
+			break;
+	}
+	if(result >= 0) {
+		if(fileyear < clm.header.firstyear+clm.nyear)
+			fprintf(stdout, "last %d years of %s not checked, input files end in %d\n", clm.header.firstyear+clm.nyear-fileyear, path, fileyear-1);
+		fprintf(stdout, "%lld values checked, %lld fill values, NaN or values out of range skipped, %lld values differ, largest difference %g\n",
+			nchecked, nskipped, nmismatch, maxdiff*clm.header.scalar);
+		if(nmismatch)
+			result = 1;
+	}
+	free(values);
+	free(cells);
+	free(ilat);
+	free(ilon);
+	free(grid.data);
+	close_clm(&factors);
+	close_clm(&clm);
+	return result;
+} // of 'spot'
+
+static void usage(const char *progname) {
+	fprintf(stderr, "Use: %s stats [-cells FILE] clmfile\n", progname);
+	fprintf(stderr, "  or %s diff [-tolerance X] clmfile1 clmfile2\n", progname);
+	fprintf(stderr, "  or %s spot [-cells N] [-seed N] [-leapday drop|redistribute] [-firstyear N] clmfile path_to_gridfile var offset convert infilenames...\n", progname);
+	fprintf(stderr, "stats: prints min, max and mean of each year, -cells FILE writes those of each cell to FILE.\n");
+	fprintf(stderr, "diff: compares headers and values of the years in both files, values differing by at most X (times scalar) are counted separately. Exit status is 0 if files are equal.\n");
+	fprintf(stderr, "spot: converts N randomly sampled cells (default 100) of the NetCDF files like isimip_nc2clm_v2 with offset and convert and compares them to clmfile. The default of -leapday is like in isimip_nc2clm_v2. -firstyear is the first year of the first NetCDF file (default: first year of clmfile), years before the first year of clmfile are skipped. Quantized values are decoded with the .factors.clm file next to clmfile. Exit status is 0 if all values match.\n");
+	exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+	int arg = 2, ncheck = 100, leapday = -1, firstyear = INT_MIN;
+	unsigned int seed = 1;
+	double tolerance = 0;
+	const char *cellpath = NULL;
+
+	if(argc < 3)
+		usage(argv[0]);
+	if(strcmp(argv[1], "stats") == 0) {
+		for(; arg<argc && argv[arg][0] == '-'; arg++) {
+			if(strcmp(argv[arg], "-cells") == 0 && arg+1 < argc)
+				cellpath = argv[++arg];
+			else
+				usage(argv[0]);
+		}
+		if(arg+1 != argc)
+			usage(argv[0]);
+		return stats(argv[arg], cellpath);
+	}
+	if(strcmp(argv[1], "diff") == 0) {
+		for(; arg<argc && argv[arg][0] == '-'; arg++) {
+			if(strcmp(argv[arg], "-tolerance") == 0 && arg+1 < argc)
+				tolerance = atof(argv[++arg]);
+			else
+				usage(argv[0]);
+		}
+		if(arg+2 != argc)
+			usage(argv[0]);
+		return diff(argv[arg], argv[arg+1], tolerance);
+	}
+	if(strcmp(argv[1], "spot") == 0) {
+		for(; arg<argc && argv[arg][0] == '-'; arg++) {
+			if(strcmp(argv[arg], "-cells") == 0 && arg+1 < argc)
+				ncheck = atoi(argv[++arg]);
+			else if(strcmp(argv[arg], "-seed") == 0 && arg+1 < argc)
+				seed = (unsigned int)atoi(argv[++arg]);
+			else if(strcmp(argv[arg], "-leapday") == 0 && arg+1 < argc) {
+				arg++;
+				if(strcmp(argv[arg], "drop") == 0)
+					leapday = LEAPDAY_DROP;
+				else if(strcmp(argv[arg], "redistribute") == 0)
+					leapday = LEAPDAY_REDISTRIBUTE;
+				else
+					usage(argv[0]);
+			} else if(strcmp(argv[arg], "-firstyear") == 0 && arg+1 < argc)
+				firstyear = atoi(argv[++arg]);
+			else
+				usage(argv[0]);
+		}
+		if(arg+6 > argc || ncheck < 1)
+			usage(argv[0]);
+		/* default of isimip_nc2clm_v2 */
+		if(leapday < 0)
+			leapday = (strcmp(argv[arg+2], "pr") == 0 || strcmp(argv[arg+2], "prsn") == 0 || strcmp(argv[arg+2], "prec") == 0) ?
+				LEAPDAY_REDISTRIBUTE : LEAPDAY_DROP;
+		return spot(argv[arg], argv[arg+1], argv[arg+2], (float)atof(argv[arg+3]), (float)atof(argv[arg+4]),
+			argc-arg-5, argv+arg+5, ncheck, seed, leapday, firstyear);
+	}
+	usage(argv[0]);
+	return 0;
+} // of 'main'
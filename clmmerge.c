@@ -0,0 +1,343 @@
+/*
+ * clmmerge.c
+ *
+ *  Joins CLM files of consecutive years, e.g. written by isimip_nc2clm_v2
+ *  with -startyear and -endyear in separate jobs, into one CLM file.
+ *  The headers of all files must be equal except for firstyear and nyear and
+ *  the years must be continuous. The values are copied within the kernel
+ *  with copy_file_range (read and written if the file systems do not
+ *  support it), the header with the combined number of years is written
+ *  after all values
+ *  Use: clmmerge outfile clmfile1 clmfile2 ...
+ *         files are sorted by firstyear; further outputs of isimip_nc2clm_v2
+ *         (quantization factors .factors.clm of -quantize, aggregates like
+ *         .monthly_mean.clm of -monthly and -annual) are joined as well if
+ *         all files have them
+ */
+/* compile e.g.:
+ * gcc -O2 clmmerge.c -o clmmerge
+ */
+
+#define _GNU_SOURCE // copy_file_range
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#define LPJ_FLOAT 3
+#define LPJ_SHORT 1
+#ifndef COPY_BLOCK
+#define COPY_BLOCK (64*1024*1024) // bytes copied at once
+#endif
+
+typedef struct {
+	int version, order, firstyear, nyear, firstcell, ncell, nband;
+	float cellsize, scalar;
+} Header; // like in isimip_nc2clm_v2.c
+
+// ***** swap-functions *****
+static void swap(char *a,char *b){
+	char h;
+	h=*a;
+	*a=*b;
+	*b=h;
+}
+
+static int swapint(int x){
+	swap((char *)&x,(char *)(&x)+3);
+	swap((char *)&x+1,(char *)(&x)+2);
+	return x;
+}
+
+static double wallclock(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// ***** files to join *****
+typedef struct {
+	const char *path;
+	int fd;
+	char raw[7+sizeof(Header)+sizeof(float)+sizeof(int)]; // header as in file
+	Header header; // in byte order of this machine
+	int datatype; // LPJ_SHORT or LPJ_FLOAT
+	int swapped; // file is in the other byte order
+	size_t headersize;
+	off_t yearsize; // bytes of one year of all cells
+	struct stat st;
+} Shard;
+
+/* reads header of CLM file path and checks that it holds all years of the
+ * header, returns 0 on success */
+static int open_shard(Shard *s, const char *path) {
+	int datatype;
+	s->path = path;
+	s->fd = open(path, O_RDONLY);
+	if(s->fd < 0 || fstat(s->fd, &s->st)) {
+		fprintf(stderr, "Error opening %s\n", path);
+		return -1;
+	}
+	s->headersize = 7+sizeof(Header);
+	if(read(s->fd, s->raw, s->headersize) != (ssize_t)s->headersize || strncmp(s->raw, "LPJCLIM", 7)) {
+		fprintf(stderr, "Error: %s is not a CLM file\n", path);
+		return -1;
+	}
+	memcpy(&s->header, s->raw+7, sizeof(Header));
+	s->swapped = (s->header.version < 1 || s->header.version > 3);
+	if(s->swapped) {
+		s->header.version = swapint(s->header.version);
+		s->header.order = swapint(s->header.order);
+		s->header.firstyear = swapint(s->header.firstyear);
+		s->header.nyear = swapint(s->header.nyear);
+		s->header.firstcell = swapint(s->header.firstcell);
+		s->header.ncell = swapint(s->header.ncell);
+		s->header.nband = swapint(s->header.nband);
+		// cellsize and scalar are only compared
+	}
+	if(s->header.version < 1 || s->header.version > 3) {
+		fprintf(stderr, "Error: cannot determine endian of %s\n", path);
+		return -1;
+	}
+	s->datatype = LPJ_SHORT;
+	if(s->header.version == 3) {
+		if(read(s->fd, s->raw+s->headersize, sizeof(float)+sizeof(int)) != sizeof(float)+sizeof(int)) {
+			fprintf(stderr, "Error: %s is too short for a CLM3 file\n", path);
+			return -1;
+		}
+		memcpy(&datatype, s->raw+s->headersize+sizeof(float), sizeof(int));
+		s->datatype = s->swapped ? swapint(datatype) : datatype;
+		s->headersize += sizeof(float)+sizeof(int);
+	}
+	if(s->datatype != LPJ_SHORT && s->datatype != LPJ_FLOAT) {
+		fprintf(stderr, "Error: data type %d of %s not supported\n", s->datatype, path);
+		return -1;
+	}
+	if(s->header.ncell < 1 || s->header.nband < 1 || s->header.nyear < 0) {
+		fprintf(stderr, "Error: invalid header in %s\n", path);
+		return -1;
+	}
+	s->yearsize = (off_t)s->header.ncell*s->header.nband*((s->datatype == LPJ_FLOAT) ? sizeof(float) : sizeof(short));
+	if(s->st.st_size < (off_t)s->headersize+s->header.nyear*s->yearsize) {
+		fprintf(stderr, "Error: %s holds only %lld of %d years, conversion not finished\n", path,
+			(long long)((s->st.st_size-(off_t)s->headersize)/s->yearsize), s->header.nyear);
+		return -1;
+	}
+	if(s->st.st_size > (off_t)s->headersize+s->header.nyear*s->yearsize)
+		fprintf(stdout, "Warning: %lld bytes after year %d of %s are ignored\n",
+			(long long)(s->st.st_size-(off_t)s->headersize-s->header.nyear*s->yearsize), s->header.firstyear+s->header.nyear-1, path);
+	return 0;
+} // of 'open_shard'
+
+static int compare_firstyear(const void *a, const void *b) {
+	return ((const Shard *)a)->header.firstyear-((const Shard *)b)->header.firstyear;
+}
+
+/* checks that headers of all shards match the first one and that years are
+ * continuous, shards are sorted by firstyear; returns 0 on success */
+static int check_shards(Shard *shards, int n) {
+	int i, status = 0;
+	const Shard *s, *first = shards;
+	qsort(shards, n, sizeof(Shard), compare_firstyear);
+	for(i=1; i<n; i++) {
+		s = shards+i;
+		/* header of same byte order is equal except for firstyear and nyear,
+		 * cellsize and scalar are compared in the byte order of the file */
+		if(s->swapped != first->swapped || s->header.version != first->header.version || s->header.order != first->header.order ||
+		   s->header.firstcell != first->header.firstcell || s->header.ncell != first->header.ncell || s->header.nband != first->header.nband ||
+		   memcmp(&s->header.cellsize, &first->header.cellsize, sizeof(float)) || memcmp(&s->header.scalar, &first->header.scalar, sizeof(float)) ||
+		   s->datatype != first->datatype || memcmp(s->raw+7+sizeof(Header), first->raw+7+sizeof(Header), s->headersize-7-sizeof(Header))) {
+			fprintf(stderr, "Error: header of %s does not match %s\n", s->path, first->path);
+			status = -1;
+		}
+		if(s->header.firstyear != s[-1].header.firstyear+s[-1].header.nyear) {
+			fprintf(stderr, "Error: %s starts with %d, %s ends with %d\n", s->path, s->header.firstyear,
+				s[-1].path, s[-1].header.firstyear+s[-1].header.nyear-1);
+			status = -1;
+		}
+	}
+	return status;
+} // of 'check_shards'
+
+/* copies size bytes from offset of fd_in to the end of fd_out, with
+ * copy_file_range unless *fallback is set, which is set if the file systems
+ * do not support it; returns 0 on success */
+static int copy_values(int fd_in, off_t offset, int fd_out, off_t size, int *fallback) {
+	ssize_t n;
+	char *block;
+	while(size > 0 && !*fallback) {
+		n = copy_file_range(fd_in, &offset, fd_out, NULL, (size > COPY_BLOCK) ? COPY_BLOCK : size, 0);
+		if(n < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) {
+			*fallback = 1;
+			break;
+		}
+		if(n <= 0)
+			return -1;
+		size -= n;
+	}
+	if(size == 0)
+		return 0;
+	block = (char *)malloc((size > COPY_BLOCK) ? COPY_BLOCK : size);
+	if(block == NULL) {
+		fprintf(stderr, "Error allocating memory for copy\n");
+		return -1;
+	}
+	while(size > 0) {
+		n = pread(fd_in, block, (size > COPY_BLOCK) ? COPY_BLOCK : size, offset);
+		if(n <= 0 || write(fd_out, block, n) != n) {
+			free(block);
+			return -1;
+		}
+		offset += n;
+		size -= n;
+	}
+	free(block);
+	return 0;
+} // of 'copy_values'
+
+/* joins the n CLM files paths into outpath, returns 0 on success */
+static int merge(const char *outpath, char **paths, int n) {
+	Shard *shards;
+	struct stat st;
+	int i, fd, nyear, fallback = 0, status = 0;
+	off_t bytes = 0;
+	double start = wallclock(), seconds;
+	shards = (Shard *)calloc(n, sizeof(Shard));
+	if(shards == NULL) {
+		fprintf(stderr, "Error allocating memory for list of files\n");
+		return -1;
+	}
+	for(i=0; i<n; i++)
+		shards[i].fd = -1;
+	for(i=0; i<n && status == 0; i++)
+		status = open_shard(&shards[i], paths[i]);
+	if(status == 0)
+		status = check_shards(shards, n);
+	for(i=0; i<n && status == 0; i++)
+		if(stat(outpath, &st) == 0 && st.st_dev == shards[i].st.st_dev && st.st_ino == shards[i].st.st_ino) {
+			fprintf(stderr, "Error: %s is one of the files to join\n", outpath);
+			status = -1;
+		}
+	fd = -1;
+	if(status == 0) {
+		fd = open(outpath, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+		if(fd < 0) {
+			fprintf(stderr, "Error creating %s\n", outpath);
+			status = -1;
+		}
+	}
+	/* header with nyear 0 until all values are copied */
+	for(i=0, nyear=0; i<n; i++)
+		nyear += shards[i].header.nyear;
+	if(status == 0) {
+		memset(shards[0].raw+7+3*sizeof(int), 0, sizeof(int));
+		if(write(fd, shards[0].raw, shards[0].headersize) != (ssize_t)shards[0].headersize) {
+			fprintf(stderr, "Error writing header of %s\n", outpath);
+			status = -1;
+		}
+	}
+	for(i=0; i<n && status == 0; i++) {
+		fprintf(stdout, "%s: years %d-%d\n", shards[i].path, shards[i].header.firstyear, shards[i].header.firstyear+shards[i].header.nyear-1);
+		if(copy_values(shards[i].fd, shards[i].headersize, fd, shards[i].header.nyear*shards[i].yearsize, &fallback)) {
+			fprintf(stderr, "Error copying values of %s to %s: %s\n", shards[i].path, outpath, strerror(errno));
+			status = -1;
+		}
+		bytes += shards[i].header.nyear*shards[i].yearsize;
+	}
+	if(status == 0) {
+		i = shards[0].swapped ? swapint(nyear) : nyear;
+		if(pwrite(fd, &i, sizeof(int), 7+3*sizeof(int)) != sizeof(int)) {
+			fprintf(stderr, "Error writing header of %s\n", outpath);
+			status = -1;
+		}
+	}
+	if(fd >= 0 && close(fd)) {
+		fprintf(stderr, "Error closing %s\n", outpath);
+		status = -1;
+	}
+	seconds = wallclock()-start;
+	if(status == 0)
+		fprintf(stdout, "%s: years %d-%d, %.1f MB copied in %.2f s (%.1f MB/s, %s)\n", outpath, shards[0].header.firstyear, shards[0].header.firstyear+nyear-1,
+			bytes/(1024.0*1024.0), seconds, (seconds > 0) ? bytes/(1024.0*1024.0)/seconds : 0, fallback ? "read and write" : "copy_file_range");
+	for(i=0; i<n; i++)
+		if(shards[i].fd >= 0)
+			close(shards[i].fd);
+	free(shards);
+	return status;
+} // of 'merge'
+
+/* further outputs of isimip_nc2clm_v2 named like the CLM file with suffix
+ * instead of .clm, joined if all files have them */
+static const char *suffixes[] = {
+	".factors.clm", // -quantize
+	".monthly_sum.clm", ".monthly_mean.clm", ".monthly_min.clm", ".monthly_max.clm", // -monthly
+	".annual_sum.clm", ".annual_mean.clm", ".annual_min.clm", ".annual_max.clm" // -annual
+};
+
+/* name of further output: path with suffix instead of .clm, like in isimip_nc2clm_v2.c */
+static char *output_path(const char *path, const char *suffix) {
+	char *newpath;
+	size_t len = strlen(path);
+	newpath = (char *)malloc(len+strlen(suffix)+1);
+	if(newpath == NULL)
+		return NULL;
+	strcpy(newpath, path);
+	if(len > 4 && strcmp(path+len-4, ".clm") == 0)
+		newpath[len-4] = '\0';
+	strcat(newpath, suffix);
+	return newpath;
+} // of 'output_path'
+
+/* joins further outputs with suffix of the n files paths if all of them
+ * have one, returns 0 on success */
+static int merge_outputs(const char *outpath, char **paths, int n, const char *suffix) {
+	char **outputs, *output;
+	int i, noutputs, status = 0;
+	outputs = (char **)calloc(n, sizeof(char *));
+	output = output_path(outpath, suffix);
+	if(outputs == NULL || output == NULL) {
+		fprintf(stderr, "Error allocating memory for names of files\n");
+		free(outputs);
+		return -1;
+	}
+	for(i=0, noutputs=0; i<n && status == 0; i++) {
+		outputs[i] = output_path(paths[i], suffix);
+		if(outputs[i] == NULL) {
+			fprintf(stderr, "Error allocating memory for names of files\n");
+			status = -1;
+		} else if(access(outputs[i], F_OK) == 0) {
+			noutputs++;
+		}
+	}
+	if(status == 0 && noutputs > 0 && noutputs < n) {
+		fprintf(stderr, "Error: only %d of %d files have a file %s\n", noutputs, n, suffix);
+		status = -1;
+	} else if(status == 0 && noutputs == n) {
+		status = merge(output, outputs, n);
+	}
+	for(i=0; i<n; i++)
+		free(outputs[i]);
+	free(outputs);
+	free(output);
+	return status;
+} // of 'merge_outputs'
+
+static void usage(const char *progname) {
+	fprintf(stderr, "Use: %s outfile clmfile1 clmfile2 ...\n", progname);
+	fprintf(stderr, "Joins CLM files of consecutive years into outfile. Headers must be equal except for firstyear and nyear. Further outputs of isimip_nc2clm_v2 (quantization factors .factors.clm, aggregates like .monthly_mean.clm) are joined as well if all files have them.\n");
+	exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+	int i, status;
+	if(argc < 3)
+		usage(argv[0]);
+	status = merge(argv[1], argv+2, argc-2);
+	for(i=0; i<(int)(sizeof(suffixes)/sizeof(suffixes[0])) && status == 0; i++)
+		status = merge_outputs(argv[1], argv+2, argc-2, suffixes[i]);
+	return status ? 1 : 0;
+}
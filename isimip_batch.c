@@ -0,0 +1,779 @@
+/*
+ * isimip_batch.c
+ *
+ *  Batch driver running isimip_nc2clm_v2 for all input files of a tree of
+ *  ISIMIP climate data, replacing the loops over datasets, scenarios and
+ *  variables of the climate_nc2clm_*.sh scripts
+ *  The input tree is scanned once for files named PREFIX_VAR[_global_daily]_
+ *  FIRSTYEAR_LASTYEAR.nc. Files of the same directory, prefix and variable
+ *  form one job converting them into
+ *  OUTPUT/DIRECTORY/VARIABLE_PREFIX_FIRSTYEAR-LASTYEAR.clm
+ *  Jobs run concurrently as long as the sum of their threads, their
+ *  estimated memory, their number and the number of their processes reading
+ *  input (more than one with -files) stay within -cpus, -mem, -jobs and -io;
+ *  the largest jobs are started first. Outputs that are already complete are
+ *  skipped, incomplete outputs are resumed. Output of each job goes to the
+ *  CLM file name with .log appended
+ *  Use: isimip_batch [-cpus N] [-mem MB] [-jobs N] [-io N] [-threads N] [-dry-run] configfile
+ *  The config file holds one setting per line, # starts a comment:
+ *    program PATH        isimip_nc2clm_v2 executable
+ *    grid PATH           LPJmL grid file
+ *    input DIR           root of input tree
+ *    output DIR          root of output tree
+ *    options ARGS...     further options of isimip_nc2clm_v2 for all jobs
+ *    drop TOKENS...      tokens of the file prefix left out of output names,
+ *                        e.g. the ensemble member r1i1p1f1
+ *    variable NAME NCVAR OFFSET CONVERT SCALE [FLAGS...]
+ *                        output variable NAME converted from NCVAR, FLAGS
+ *                        are options of isimip_nc2clm_v2 like -float; for
+ *                        -derive NAME VAR2 the files of VAR2 are added
+ */
+/* compile e.g.:
+ * gcc -O2 isimip_batch.c -o isimip_batch -lnetcdf
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <time.h>
+#include <errno.h>
+#include <netcdf.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define LPJ_FLOAT 3
+#define MAXARGS 64
+#define NC_CACHE_MAX (1024L*1024*1024) // like in isimip_nc2clm_v2.c
+
+typedef struct {
+	int version, order, firstyear, nyear, firstcell, ncell, nband;
+	float cellsize, scalar;
+} Header; // like in isimip_nc2clm_v2.c
+
+// ***** input files found in input tree *****
+typedef struct {
+	char *path;
+	char *dir; // directory relative to input root
+	char *prefix; // part of file name before variable
+	char *var;
+	int firstyear, lastyear;
+	long long size;
+} Ncfile;
+
+static Ncfile *ncfiles = NULL;
+static int nncfiles = 0;
+static size_t inputlen; // length of path of input root
+
+/* splits NAME into prefix, variable and years, returns 0 on success */
+static int parse_filename(const char *name, char **prefix, char **var, int *firstyear, int *lastyear) {
+	char *stem, *sep, *suffix;
+	size_t len = strlen(name);
+	/* _FIRSTYEAR_LASTYEAR.nc */
+	if(len < 13 || strcmp(name+len-3, ".nc") || name[len-13] != '_' || name[len-8] != '_')
+		return -1;
+	if(sscanf(name+len-12, "%4d_%4d", firstyear, lastyear) != 2 || *lastyear < *firstyear)
+		return -1;
+	stem = strndup(name, len-13);
+	suffix = strstr(stem, "_global_daily");
+	if(suffix != NULL && suffix[strlen("_global_daily")] == '\0')
+		*suffix = '\0';
+	sep = strrchr(stem, '_');
+	if(sep == NULL) {
+		*prefix = strdup("");
+		*var = stem;
+	} else {
+		*sep = '\0';
+		*prefix = stem;
+		*var = strdup(sep+1);
+	}
+	return 0;
+} // of 'parse_filename'
+
+static int add_ncfile(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+	Ncfile *f;
+	const char *name = path+ftw->base;
+	if(type != FTW_F)
+		return 0;
+	ncfiles = (Ncfile *)realloc(ncfiles, sizeof(Ncfile)*(nncfiles+1));
+	if(ncfiles == NULL) {
+		fprintf(stderr, "Error allocating memory for list of files\n");
+		exit(-1);
+	}
+	f = &ncfiles[nncfiles];
+	if(parse_filename(name, &f->prefix, &f->var, &f->firstyear, &f->lastyear))
+		return 0;
+	f->path = strdup(path);
+	f->dir = ((size_t)ftw->base > inputlen+1) ? strndup(path+inputlen+1, ftw->base-inputlen-1) : strdup("");
+	if(strlen(f->dir) > 0)
+		f->dir[strlen(f->dir)-1] = '\0'; // trailing '/'
+	f->size = st->st_size;
+	nncfiles++;
+	return 0;
+} // of 'add_ncfile'
+
+static int compare_ncfiles(const void *a, const void *b) {
+	const Ncfile *fa = (const Ncfile *)a, *fb = (const Ncfile *)b;
+	int cmp = strcmp(fa->dir, fb->dir);
+	if(cmp == 0)
+		cmp = strcmp(fa->prefix, fb->prefix);
+	if(cmp == 0)
+		cmp = strcmp(fa->var, fb->var);
+	if(cmp == 0)
+		cmp = fa->firstyear-fb->firstyear;
+	return cmp;
+}
+
+// ***** settings of config file *****
+typedef struct {
+	char *name, *ncvar;
+	char *offset, *convert, *scale;
+	int nflags;
+	char **flags;
+	char *var2; // second variable of -derive, NULL if none
+} Variable;
+
+typedef struct {
+	char *program, *grid, *input, *output;
+	int noptions;
+	char **options;
+	int ndrop;
+	char **drop;
+	int nvar;
+	Variable *vars;
+	int cpus, jobs, io, threads; // io: processes reading input at the same time
+	long long mem; // MB
+	int dry_run;
+} Config;
+
+/* splits line into words, returns number of words */
+static int split(char *line, char **words, int maxwords) {
+	char *token;
+	int n = 0;
+	for(token=strtok(line, " \t\r\n"); token!=NULL && n<maxwords; token=strtok(NULL, " \t\r\n")) {
+		if(token[0] == '#')
+			break;
+		words[n++] = strdup(token);
+	}
+	return n;
+}
+
+static char **copy_words(char **words, int n) {
+	char **copy = (char **)malloc(sizeof(char *)*(n > 0 ? n : 1));
+	if(copy == NULL) {
+		fprintf(stderr, "Error allocating memory for config\n");
+		exit(-1);
+	}
+	memcpy(copy, words, sizeof(char *)*n);
+	return copy;
+}
+
+/* reads config file, exits on error */
+static void read_config(const char *filename, Config *config) {
+	FILE *file;
+	char line[16384], *words[MAXARGS];
+	int n, i, lineno = 0;
+	Variable *v;
+	file = fopen(filename, "r");
+	if(file == NULL) {
+		fprintf(stderr, "Error opening config file %s\n", filename);
+		exit(-1);
+	}
+	while(fgets(line, sizeof(line), file) != NULL) {
+		lineno++;
+		n = split(line, words, MAXARGS);
+		if(n == 0)
+			continue;
+		if(strcmp(words[0], "program") == 0 && n == 2) {
+			config->program = words[1];
+		} else if(strcmp(words[0], "grid") == 0 && n == 2) {
+			config->grid = words[1];
+		} else if(strcmp(words[0], "input") == 0 && n == 2) {
+			config->input = words[1];
+		} else if(strcmp(words[0], "output") == 0 && n == 2) {
+			config->output = words[1];
+		} else if(strcmp(words[0], "options") == 0) {
+			config->noptions = n-1;
+			config->options = copy_words(words+1, n-1);
+		} else if(strcmp(words[0], "drop") == 0) {
+			config->ndrop = n-1;
+			config->drop = copy_words(words+1, n-1);
+		} else if(strcmp(words[0], "variable") == 0 && n >= 6) {
+			config->vars = (Variable *)realloc(config->vars, sizeof(Variable)*(config->nvar+1));
+			if(config->vars == NULL) {
+				fprintf(stderr, "Error allocating memory for config\n");
+				exit(-1);
+			}
+			v = &config->vars[config->nvar++];
+			v->name = words[1];
+			v->ncvar = words[2];
+			v->offset = words[3];
+			v->convert = words[4];
+			v->scale = words[5];
+			v->nflags = n-6;
+			v->flags = copy_words(words+6, n-6);
+			v->var2 = NULL;
+			for(i=0; i<v->nflags; i++)
+				if(strcmp(v->flags[i], "-derive") == 0 && i+2 < v->nflags)
+					v->var2 = v->flags[i+2];
+		} else {
+			fprintf(stderr, "Invalid line %d in config file %s\n", lineno, filename);
+			exit(-1);
+		}
+	}
+	fclose(file);
+	if(config->program == NULL || config->grid == NULL || config->input == NULL || config->output == NULL || config->nvar == 0) {
+		fprintf(stderr, "Config file %s must set program, grid, input, output and at least one variable\n", filename);
+		exit(-1);
+	}
+} // of 'read_config'
+
+// ***** jobs *****
+#define JOB_PENDING 0
+#define JOB_RUNNING 1
+#define JOB_DONE 2
+#define JOB_FAILED 3
+#define JOB_COMPLETE 4 // output was complete already
+
+typedef struct {
+	const Variable *var;
+	int first, nfiles; // files of ncfiles
+	int first2; // files of second variable of derived variable, -1 if none
+	int firstyear, lastyear;
+	long long size; // bytes of input files
+	long long mem; // estimated memory in MB
+	int nproc; // processes reading input files, >1 with -files
+	char *outfile;
+	int resume;
+	int state;
+	pid_t pid;
+	double start, seconds;
+	int status;
+} Job;
+
+static double wallclock(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/* creates directory and its parents */
+static int make_dirs(const char *path) {
+	char *dir = strdup(path), *p;
+	for(p=dir+1; *p!='\0'; p++) {
+		if(*p == '/') {
+			*p = '\0';
+			if(mkdir(dir, 0777) && errno != EEXIST) {
+				free(dir);
+				return -1;
+			}
+			*p = '/';
+		}
+	}
+	free(dir);
+	return 0;
+}
+
+/* name of output file without dropped tokens of prefix */
+static char *output_name(const Config *config, const Ncfile *f, const Variable *v, int firstyear, int lastyear) {
+	char name[4096], prefix[1024], *copy, *token;
+	int i;
+	prefix[0] = '\0';
+	copy = strdup(f->prefix);
+	for(token=strtok(copy, "_"); token!=NULL; token=strtok(NULL, "_")) {
+		for(i=0; i<config->ndrop && strcmp(token, config->drop[i]); i++)
+			;
+		if(i < config->ndrop)
+			continue;
+		strncat(prefix, "_", sizeof(prefix)-strlen(prefix)-1);
+		strncat(prefix, token, sizeof(prefix)-strlen(prefix)-1);
+	}
+	free(copy);
+	snprintf(name, sizeof(name), "%s/%s%s%s%s_%d-%d.clm", config->output, f->dir, (strlen(f->dir) > 0) ? "/" : "", v->name, prefix, firstyear, lastyear);
+	return strdup(name);
+} // of 'output_name'
+
+/* returns 1 if CLM file holds all years, 0 if it is incomplete and -1 if it does not exist */
+static int is_complete(const char *path, int nyear) {
+	FILE *file;
+	char headername[7];
+	Header header;
+	int datatype = 0;
+	long long headersize = 7+sizeof(Header), size;
+	struct stat st;
+	if(stat(path, &st))
+		return -1;
+	file = fopen(path, "rb");
+	if(file == NULL)
+		return 0;
+	if(fread(headername, 7, 1, file) != 1 || fread(&header, sizeof(Header), 1, file) != 1 || strncmp(headername, "LPJCLIM", 7)) {
+		fclose(file);
+		return 0;
+	}
+	if(header.version == 3) {
+		fseek(file, sizeof(float), SEEK_CUR);
+		if(fread(&datatype, sizeof(int), 1, file) != 1)
+			datatype = 0;
+		headersize += sizeof(float)+sizeof(int);
+	}
+	fclose(file);
+	size = headersize+(long long)header.nyear*header.ncell*header.nband*((datatype == LPJ_FLOAT) ? sizeof(float) : sizeof(short));
+	return header.nyear == nyear && st.st_size == size;
+} // of 'is_complete'
+
+/* finds files of var in same directory and with same prefix as files of job, returns index or -1 */
+static int find_files(const Job *job, const char *var) {
+	const Ncfile *f = &ncfiles[job->first];
+	int i, j;
+	for(i=0; i<nncfiles; i++) {
+		if(strcmp(ncfiles[i].dir, f->dir) || strcmp(ncfiles[i].prefix, f->prefix) || strcmp(ncfiles[i].var, var))
+			continue;
+		/* same years in all files */
+		for(j=0; j<job->nfiles; j++)
+			if(i+j >= nncfiles || strcmp(ncfiles[i+j].var, var) || strcmp(ncfiles[i+j].prefix, f->prefix) ||
+			   ncfiles[i+j].firstyear != ncfiles[job->first+j].firstyear || ncfiles[i+j].lastyear != ncfiles[job->first+j].lastyear)
+				return -1;
+		return i;
+	}
+	return -1;
+}
+
+static int compare_jobs(const void *a, const void *b) {
+	const Job *ja = (const Job *)a, *jb = (const Job *)b;
+	return (ja->size < jb->size) ? 1 : (ja->size > jb->size) ? -1 : 0;
+}
+
+/* number of grid points of one day of ncvar in NetCDF file, -1 on error;
+ * cache is set to the chunk cache isimip_nc2clm_v2 uses for ncvar if all
+ * grid points are read, 0 if stored contiguous */
+static long long grid_points(const char *path, const char *ncvar, long long *cache) {
+	int ncid, lat_id, lon_id, var_id, storage;
+	size_t latlen, lonlen, chunk[3];
+	*cache = 0;
+	if(nc_open(path, NC_NOWRITE, &ncid) != NC_NOERR)
+		return -1;
+	if(nc_inq_dimid(ncid, "lat", &lat_id) != NC_NOERR || nc_inq_dimlen(ncid, lat_id, &latlen) != NC_NOERR ||
+	   nc_inq_dimid(ncid, "lon", &lon_id) != NC_NOERR || nc_inq_dimlen(ncid, lon_id, &lonlen) != NC_NOERR) {
+		nc_close(ncid);
+		return -1;
+	}
+	/* two time blocks of the chunks, at most NC_CACHE_MAX like in isimip_nc2clm_v2.c */
+	if(nc_inq_varid(ncid, ncvar, &var_id) == NC_NOERR && nc_inq_var_chunking(ncid, var_id, &storage, chunk) == NC_NOERR &&
+	   storage == NC_CHUNKED) {
+		*cache = 2*(long long)sizeof(float)*chunk[0]*latlen*lonlen;
+		if(*cache > NC_CACHE_MAX)
+			*cache = NC_CACHE_MAX;
+	}
+	nc_close(ncid);
+	return (long long)latlen*lonlen;
+} // of 'grid_points'
+
+/* value of option name of isimip_nc2clm_v2 for variable v, NULL if not set;
+ * options of config follow flags of v on the command line, so they win */
+static const char *option_value(const Config *config, const Variable *v, const char *name) {
+	const char *value = NULL;
+	int i;
+	for(i=0; i<v->nflags; i++) {
+		if(strcmp(v->flags[i], "-derive") == 0)
+			i += 2;
+		else if(strcmp(v->flags[i], name) == 0 && i+1 < v->nflags)
+			value = v->flags[++i];
+	}
+	for(i=0; i<config->noptions; i++)
+		if(strcmp(config->options[i], name) == 0 && i+1 < config->noptions)
+			value = config->options[++i];
+	return value;
+} // of 'option_value'
+
+/* number of processes of isimip_nc2clm_v2 converting files of job concurrently */
+static int job_processes(const Config *config, const Job *job) {
+	const char *value = option_value(config, job->var, "-files");
+	if(value == NULL || atoi(value) < 2)
+		return 1;
+	return (atoi(value) < job->nfiles) ? atoi(value) : job->nfiles;
+}
+
+/* estimated memory in MB of job like stream_chunk of isimip_nc2clm_v2:
+ * year buffers, per-cell arrays, values read and chunk caches of each of
+ * the processes of -files; yearsize is the size of values of one year of all
+ * input variables, cache the chunk cache of one variable */
+static long long job_memory(const Config *config, const Job *job, int ncells, long long yearsize, long long cache) {
+	const char *value;
+	long long mem, nbuf = 1, chunk = 0;
+	int nvar = (job->var->var2 != NULL) ? 2 : 1;
+	if((value = option_value(config, job->var, "-max-mem")) != NULL && atol(value) > 0)
+		return job->nproc*atol(value);
+	if((value = option_value(config, job->var, "-pipeline")) != NULL && atoi(value) > 1)
+		nbuf = atoi(value);
+	if((value = option_value(config, job->var, "-chunk")) != NULL && atoi(value) > 0)
+		chunk = (atoi(value) > 366) ? 366 : atoi(value);
+	mem = nbuf*ncells*(365*(long long)(sizeof(float)+sizeof(short))+sizeof(float)) +
+		(long long)ncells*(2*sizeof(int)+2*sizeof(size_t)+2*sizeof(short)) + nvar*cache;
+	/* one chunk of days read in streaming mode, a whole year for each year buffer otherwise */
+	mem += (chunk > 0) ? yearsize/366*chunk : nbuf*yearsize;
+	return job->nproc*mem/(1024*1024)+1;
+} // of 'job_memory'
+
+/* builds jobs of all variables from files found, returns number of jobs */
+static int make_jobs(const Config *config, int ncells, Job **jobs) {
+	Job *job;
+	const Variable *v;
+	int i, j, k, n = 0;
+	long long yearsize, npoints, cache;
+	*jobs = NULL;
+	for(k=0; k<config->nvar; k++) {
+		v = &config->vars[k];
+		for(i=0; i<nncfiles; i=j) {
+			/* files of same directory, prefix and variable are sorted by years */
+			for(j=i+1; j<nncfiles && !strcmp(ncfiles[j].dir, ncfiles[i].dir) && !strcmp(ncfiles[j].prefix, ncfiles[i].prefix) &&
+			    !strcmp(ncfiles[j].var, ncfiles[i].var); j++)
+				;
+			if(strcmp(ncfiles[i].var, v->ncvar))
+				continue;
+			*jobs = (Job *)realloc(*jobs, sizeof(Job)*(n+1));
+			if(*jobs == NULL) {
+				fprintf(stderr, "Error allocating memory for jobs\n");
+				exit(-1);
+			}
+			job = &(*jobs)[n];
+			job->var = v;
+			job->first = i;
+			job->nfiles = j-i;
+			job->firstyear = ncfiles[i].firstyear;
+			job->lastyear = ncfiles[j-1].lastyear;
+			job->first2 = -1;
+			job->state = JOB_PENDING;
+			job->status = 0;
+			job->seconds = 0;
+			/* uncompressed values of one year as read by isimip_nc2clm_v2, file size of one year if grid is unknown */
+			npoints = grid_points(ncfiles[i].path, v->ncvar, &cache);
+			yearsize = (npoints > 0) ? npoints*366*(long long)sizeof(float) : 0;
+			for(job->size=0; i<j; i++) {
+				job->size += ncfiles[i].size;
+				if(ncfiles[i].size/(ncfiles[i].lastyear-ncfiles[i].firstyear+1) > yearsize)
+					yearsize = ncfiles[i].size/(ncfiles[i].lastyear-ncfiles[i].firstyear+1);
+				if(i > job->first && ncfiles[i].firstyear != ncfiles[i-1].lastyear+1) {
+					fprintf(stderr, "Warning: gap between %s and %s, skipped\n", ncfiles[i-1].path, ncfiles[i].path);
+					job->state = JOB_FAILED;
+				}
+			}
+			if(v->var2 != NULL) {
+				job->first2 = find_files(job, v->var2);
+				if(job->first2 < 0) {
+					fprintf(stderr, "Warning: no files of %s matching %s, skipped\n", v->var2, ncfiles[job->first].path);
+					job->state = JOB_FAILED;
+				} else {
+					for(i=job->first2; i<job->first2+job->nfiles; i++)
+						job->size += ncfiles[i].size;
+					yearsize *= 2;
+				}
+			}
+			job->nproc = job_processes(config, job);
+			job->mem = job_memory(config, job, ncells, yearsize, cache);
+			job->outfile = output_name(config, &ncfiles[job->first], v, job->firstyear, job->lastyear);
+			if(job->state == JOB_FAILED) {
+				n++;
+				continue;
+			}
+			switch(is_complete(job->outfile, job->lastyear-job->firstyear+1)) {
+				case 1:
+					job->state = JOB_COMPLETE;
+					break;
+				case 0:
+					job->resume = 1;
+					break;
+				default:
+					job->resume = 0;
+			}
+			n++;
+		}
+	}
+	qsort(*jobs, n, sizeof(Job), compare_jobs);
+	return n;
+} // of 'make_jobs'
+
+/* arguments of isimip_nc2clm_v2 for job, returns number of arguments */
+static int job_args(const Config *config, const Job *job, char **args, int maxargs) {
+	static char number[16], firstyear[16], threads[16];
+	const Variable *v = job->var;
+	int n = 0, i, k;
+	args[n++] = config->program;
+	snprintf(number, sizeof(number), "%d", job->nfiles);
+	args[n++] = number;
+	for(i=job->first; i<job->first+job->nfiles && n<maxargs; i++)
+		args[n++] = ncfiles[i].path;
+	snprintf(firstyear, sizeof(firstyear), "%d", job->firstyear);
+	if(n+9 >= maxargs)
+		return -1;
+	args[n++] = v->ncvar;
+	args[n++] = firstyear;
+	args[n++] = config->grid;
+	args[n++] = v->offset;
+	args[n++] = v->convert;
+	args[n++] = v->scale;
+	args[n++] = job->outfile;
+	for(i=0; i<v->nflags && n<maxargs; i++) {
+		args[n++] = v->flags[i];
+		if(strcmp(v->flags[i], "-derive") == 0 && i+2 < v->nflags && n+2 < maxargs) {
+			/* derived variable name, second variable and its files */
+			args[n++] = v->flags[++i];
+			args[n++] = v->flags[++i];
+			for(k=job->first2; k<job->first2+job->nfiles && n<maxargs; k++)
+				args[n++] = ncfiles[k].path;
+		}
+	}
+	for(i=0; i<config->noptions && n<maxargs; i++)
+		args[n++] = config->options[i];
+	if(config->threads > 1 && n+2 < maxargs) {
+		snprintf(threads, sizeof(threads), "%d", config->threads);
+		args[n++] = "-threads";
+		args[n++] = threads;
+	}
+	if(job->resume && n < maxargs)
+		args[n++] = "-resume";
+	if(n >= maxargs)
+		return -1;
+	args[n] = NULL;
+	return n;
+} // of 'job_args'
+
+// ***** scheduler *****
+typedef struct {
+	int cpus, jobs, io;
+	long long mem;
+} Usage;
+
+/* starts job with output to log file, returns 0 on success */
+static int start_job(const Config *config, Job *job) {
+	char **args, log[4096];
+	int maxargs, fd;
+	maxargs = 2*job->nfiles+config->noptions+job->var->nflags+16;
+	args = (char **)malloc(sizeof(char *)*(maxargs+1));
+	if(args == NULL || job_args(config, job, args, maxargs) < 0) {
+		fprintf(stderr, "Error building arguments for %s\n", job->outfile);
+		free(args);
+		return -1;
+	}
+	if(make_dirs(job->outfile)) {
+		fprintf(stderr, "Error creating directory of %s: %s\n", job->outfile, strerror(errno));
+		free(args);
+		return -1;
+	}
+	snprintf(log, sizeof(log), "%s.log", job->outfile);
+	fflush(stdout);
+	fflush(stderr);
+	job->pid = fork();
+	if(job->pid < 0) {
+		fprintf(stderr, "Error starting job for %s: %s\n", job->outfile, strerror(errno));
+		free(args);
+		return -1;
+	}
+	if(job->pid == 0) {
+		fd = open(log, O_WRONLY|O_CREAT|(job->resume ? O_APPEND : O_TRUNC), 0666);
+		if(fd >= 0) {
+			dup2(fd, STDOUT_FILENO);
+			dup2(fd, STDERR_FILENO);
+			close(fd);
+		}
+		execv(config->program, args);
+		fprintf(stderr, "Error executing %s: %s\n", config->program, strerror(errno));
+		_exit(127);
+	}
+	free(args);
+	job->state = JOB_RUNNING;
+	job->start = wallclock();
+	return 0;
+} // of 'start_job'
+
+/* returns 1 if job fits into resources left */
+static int fits(const Config *config, const Usage *used, const Job *job) {
+	if(used->jobs == 0) // always run at least one job
+		return 1;
+	return used->jobs+1 <= config->jobs && used->io+job->nproc <= config->io && used->cpus+config->threads <= config->cpus &&
+	       used->mem+job->mem <= config->mem;
+}
+
+/* runs pending jobs, largest first, while resources allow it; smaller jobs fill resources left */
+static void run_jobs(const Config *config, Job *jobs, int njobs) {
+	Usage used = {0, 0, 0, 0};
+	int i, npending = 0, status;
+	pid_t pid;
+	for(i=0; i<njobs; i++)
+		if(jobs[i].state == JOB_PENDING)
+			npending++;
+	while(npending > 0 || used.jobs > 0) {
+		for(i=0; i<njobs && npending > 0; i++) {
+			if(jobs[i].state != JOB_PENDING || !fits(config, &used, &jobs[i]))
+				continue;
+			npending--;
+			if(start_job(config, &jobs[i])) {
+				jobs[i].state = JOB_FAILED;
+				continue;
+			}
+			printf("started %s%s (%.1f GB input, %lld MB, %d running)\n", jobs[i].outfile, jobs[i].resume ? ", resumed" : "",
+			       jobs[i].size/1e9, jobs[i].mem, used.jobs+1);
+			used.jobs++;
+			used.io += jobs[i].nproc;
+			used.cpus += config->threads;
+			used.mem += jobs[i].mem;
+		}
+		if(used.jobs == 0)
+			break;
+		pid = wait(&status);
+		if(pid < 0) {
+			fprintf(stderr, "Error waiting for jobs: %s\n", strerror(errno));
+			break;
+		}
+		for(i=0; i<njobs && !(jobs[i].state == JOB_RUNNING && jobs[i].pid == pid); i++)
+			;
+		if(i == njobs)
+			continue;
+		jobs[i].seconds = wallclock()-jobs[i].start;
+		jobs[i].status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+		jobs[i].state = (jobs[i].status == 0) ? JOB_DONE : JOB_FAILED;
+		printf("%s %s in %.1f s\n", (jobs[i].state == JOB_DONE) ? "finished" : "FAILED", jobs[i].outfile, jobs[i].seconds);
+		used.jobs--;
+		used.io -= jobs[i].nproc;
+		used.cpus -= config->threads;
+		used.mem -= jobs[i].mem;
+	}
+} // of 'run_jobs'
+
+static void print_summary(const Job *jobs, int njobs, double seconds) {
+	int i, ndone = 0, ncomplete = 0, nfailed = 0;
+	long long size = 0;
+	for(i=0; i<njobs; i++) {
+		switch(jobs[i].state) {
+			case JOB_DONE:
+				ndone++;
+				size += jobs[i].size;
+				break;
+			case JOB_COMPLETE:
+				ncomplete++;
+				break;
+			case JOB_FAILED:
+				nfailed++;
+				break;
+		}
+	}
+	printf("\nSummary: %d jobs, %d converted, %d complete already, %d failed, %.1f s", njobs, ndone, ncomplete, nfailed, seconds);
+	if(seconds > 0)
+		printf(", %.1f MB/s input", size/seconds/1e6);
+	printf("\n");
+	for(i=0; i<njobs; i++)
+		if(jobs[i].state == JOB_FAILED)
+			printf("  failed: %s (status %d, see %s.log)\n", jobs[i].outfile, jobs[i].status, jobs[i].outfile);
+} // of 'print_summary'
+
+/* reads number of cells from grid file, returns -1 on error */
+static int grid_cells(const char *filename) {
+	FILE *file;
+	char headername[7];
+	Header header;
+	file = fopen(filename, "rb");
+	if(file == NULL)
+		return -1;
+	if(fread(headername, 7, 1, file) != 1 || fread(&header, sizeof(Header), 1, file) != 1) {
+		fclose(file);
+		return -1;
+	}
+	fclose(file);
+	return header.ncell;
+}
+
+static void usage(const char *progname) {
+	fprintf(stderr, "Usage: %s [-cpus N] [-mem MB] [-jobs N] [-io N] [-threads N] [-dry-run] configfile\n", progname);
+	fprintf(stderr, "  -cpus N: cores used by all jobs together (default: all cores)\n");
+	fprintf(stderr, "  -mem MB: memory estimated for all jobs together (default: 80%% of physical memory)\n");
+	fprintf(stderr, "  -jobs N: maximum number of jobs running at the same time (default: 4)\n");
+	fprintf(stderr, "  -io N: maximum number of processes reading input at the same time, a job with -files N counts N times (default: -jobs)\n");
+	fprintf(stderr, "  -threads N: threads of each job, passed to isimip_nc2clm_v2 (default: 1)\n");
+	fprintf(stderr, "  -dry-run: only print commands of jobs\n");
+}
+
+int main(int argc, char **argv) {
+	Config config;
+	Job *job, *jobs;
+	char **args;
+	int i, k, njobs, ncells, maxargs;
+	double time1;
+	memset(&config, 0, sizeof(config));
+	config.cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	config.mem = (long long)sysconf(_SC_PHYS_PAGES)*sysconf(_SC_PAGESIZE)/(1024*1024)*8/10;
+	config.jobs = 4;
+	config.threads = 1;
+	for(i=1; i<argc-1; i++) {
+		if(strcmp(argv[i], "-cpus") == 0 && i+1 < argc-1)
+			config.cpus = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-mem") == 0 && i+1 < argc-1)
+			config.mem = atoll(argv[++i]);
+		else if(strcmp(argv[i], "-jobs") == 0 && i+1 < argc-1)
+			config.jobs = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-io") == 0 && i+1 < argc-1)
+			config.io = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-threads") == 0 && i+1 < argc-1)
+			config.threads = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-dry-run") == 0)
+			config.dry_run = 1;
+		else {
+			usage(argv[0]);
+			return -1;
+		}
+	}
+	if(config.io == 0)
+		config.io = config.jobs;
+	if(argc < 2 || argv[argc-1][0] == '-' || config.cpus < 1 || config.jobs < 1 || config.io < 1 || config.threads < 1 || config.mem < 1) {
+		usage(argv[0]);
+		return -1;
+	}
+	read_config(argv[argc-1], &config);
+	ncells = grid_cells(config.grid);
+	if(ncells < 0) {
+		fprintf(stderr, "Error reading grid file %s\n", config.grid);
+		return -1;
+	}
+
+	/* scan input tree once */
+	time1 = wallclock();
+	inputlen = strlen(config.input);
+	while(inputlen > 1 && config.input[inputlen-1] == '/')
+		config.input[--inputlen] = '\0';
+	if(nftw(config.input, add_ncfile, 32, 0)) {
+		fprintf(stderr, "Error scanning input directory %s: %s\n", config.input, strerror(errno));
+		return -1;
+	}
+	qsort(ncfiles, nncfiles, sizeof(Ncfile), compare_ncfiles);
+	njobs = make_jobs(&config, ncells, &jobs);
+	printf("%d NetCDF files found in %s, %d jobs, %d cpus, %lld MB, %d jobs and %d processes reading input running at most\n",
+	       nncfiles, config.input, njobs, config.cpus, config.mem, config.jobs, config.io);
+
+	if(config.dry_run) {
+		for(i=0; i<njobs; i++) {
+			job = &jobs[i];
+			if(job->state == JOB_COMPLETE) {
+				printf("# complete: %s\n", job->outfile);
+				continue;
+			}
+			if(job->state == JOB_FAILED)
+				continue;
+			maxargs = 2*job->nfiles+config.noptions+job->var->nflags+16;
+			args = (char **)malloc(sizeof(char *)*(maxargs+1));
+			if(args != NULL && job_args(&config, job, args, maxargs) > 0) {
+				printf("# %.1f GB input, %lld MB, %d processes\n", job->size/1e9, job->mem, job->nproc);
+				for(k=0; args[k]!=NULL; k++)
+					printf("%s%s", args[k], (args[k+1] != NULL) ? " " : "\n");
+			}
+			free(args);
+		}
+		return 0;
+	}
+	run_jobs(&config, jobs, njobs);
+	print_summary(jobs, njobs, wallclock()-time1);
+	for(i=0; i<njobs; i++)
+		if(jobs[i].state == JOB_FAILED)
+			return 1;
+	return 0;
+} // of 'main'
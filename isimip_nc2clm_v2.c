@@ -1,575 +1,3746 @@
-/*
- * isimip_nc2clm_v2.c
- *
- *  Created from isimip_nc2clm: May 19, 2020
- *                          by: ostberg
- *  The version allows the creation of CLM3 files with data type LPJ_FLOAT
- *  Use the new optional command line argument -float for this
- *  Some additional changes compared to its predecessor including how to
- *  print error messages, how to print ranges for very small values and
- *  recognizing "prec" as precipitation in addition to "pr" and "prsn"
- */
-/* compile on cluster e.g:
- * module load netcdf-c/4.6.1/intel/serial
- * module load intel/2019.5
- * icc -O3 -xCORE-AVX2 -no-vec isimip_nc2clm_v2.c -o isimip_nc2clm_v2 -B $NETCDF_CROOT -B $NETCDF_CROOT/lib -lnetcdf -lm
- */
-
-
-#include <stdio.h>
-#include <string.h>
-#include <netcdf.h>
-#include <math.h>
-#include <stdlib.h>
-#include <stdio.h>
-#include <limits.h>
-#include <float.h>
-#define is_equal(a, b) (fabs((a) - (b)) < 0.0001)
-/* make sure that these correspond to values defined in types.h of LPJmL */
-#define LPJ_FLOAT 3
-#define LPJ_SHORT 1
-
-
-typedef struct {
-	int version, order, firstyear, nyear, firstcell, ncell, nband;
-	float cellsize, scalar;
-} Header; // cellsize = float
-
-// ***** swap-functions *****
-static void swap(char *a,char *b){
-	char h;
-	h=*a;
-	*a=*b;
-	*b=h;
-}
-
-short int swapshort(short int x){
-	swap((char *)&x,(char *)(&x)+1);
-	return x;
-}
-
-int swapint(int x){
-	swap((char *)&x,(char *)(&x)+3);
-	swap((char *)&x+1,(char *)(&x)+2);
-	return x;
-} 
-
-static float swapfloat(int num)
-{
-	float ret;
-	num=swapint(num);
-	memcpy(&ret,&num,sizeof(int));
-	return ret;
-} // of 'swapfloat'
-
-void usage(char* progname){
-	fprintf(stderr, "Use: %s number_of_infiles infilenames var firstyear path_to_gridfile offset convert scalar path_to_outfile [-float]\n", progname);
-	fprintf(stderr, "Provide as many infilenames as number_of_infiles.\n");
-	fprintf(stderr, "var: variable name in NetCDF files (only provided once, not for each file)\n");
-  fprintf(stderr, "firstyear: first year of generated CLM file, corresponds to first year in first input file\n");
-  fprintf(stderr, "path_to_gridfile: must be input grid with new header\n");
-	fprintf(stderr, "offset: offset added to values read from input file\n");
-  fprintf(stderr, "convert: conversion factor, multiplied with input values (after adding offset)\n");
-  fprintf(stderr, "scalar: scalar to be used in LPJmL when reading CLM2 (written to header, has no effect on values in this program)\n");
-	fprintf(stderr, "path_to_outfile: all input files are combined into one single output file (CLM2).\n");
-  fprintf(stderr, "-float: optional parameter to force generation of CLM3 with data type LPJ_FLOAT. Default is to omit this parameter and generate CLM2 with LPJ_SHORT.\n\n");
-  fprintf(stderr, "Note: data conversion: CLM data = (NetCDF data + offset) * convert\n");
-	exit(-1);
-}
-
-// ***** start of program *****
-int main(int argc, char *argv[0]) // *1
-{
-	
-	
-	// ***** variables *****
-	Header *grid_header, *clm_header;
-	size_t lonlen, latlen, time_len; // length of variables in NetCDF
-	size_t start[3], count[3];
-	int status, ncid, var_id, lat_id, lon_id, time_id;
-	int leap_yr = 0; // leap_yr: used as boolean (if current year is a leap-year the value is 1)
-	int firstyear = 0; // should be the first year of the first NetCDF-file (given as argument)
-	int number_yr = 0; // number_yr: number of years in current NetCDF
-	int all_years = 0; // whole number of years in clm-file
-	int nc_index = 0;
-	int clm_index = 0;
-	int cell, clm_day, column, day, febday, file, row, year; // counter-variables in loops
-	int *ilon, *ilat;
-	short *clm_writedata_short, *grid_data;
-	float convert = 0.0;
-	float offset = 0.0;
-	float scalar = 0.0;
-	float fill_value = 0.0;
-	float *clm_data, *nc_data;
-	int ncells = 0;
-  int writefloat = 0;
-  int datatype = LPJ_SHORT;
-	double *nclon, *nclat;
-	char *var, *path_to_gridfile, *path_to_outfile, *grid_headername;
-	FILE *grid_file, *clm_file;
-	short swap_grid, grid_error, file_error, memory_error, filename_mentioned;
-	long int fill_error, range_error;
-	float fieldmin, fieldmax;
-	
-	/* initialization */
-	grid_file=clm_file=NULL;
-	clm_data=nc_data=NULL;
-	ilon=ilat=NULL;
-	clm_writedata_short=grid_data=NULL;
-	nclon=nclat=NULL;
-	swap_grid=grid_error=file_error=memory_error = 0;
-	fill_error=range_error = 0;
-	
-	
-	// ***** assign Arguments *****
-	if(argc < 10)
-		usage(argv[0]);
-	int number_infiles = atoi(argv[1]);
-	if(argc != number_infiles+9 && argc != number_infiles+10)
-		usage(argv[0]);
-	
-	var = (char*)argv[number_infiles+2];
-	firstyear = atoi(argv[number_infiles+3]);
-	path_to_gridfile = (char*)argv[number_infiles+4];
-	offset = (float)atof(argv[number_infiles+5]);	
-	convert = (float)atof(argv[number_infiles+6]);	
-	scalar = (float)atof(argv[number_infiles+7]);	
-	path_to_outfile = (char*)argv[number_infiles+8];
-  if(argc==number_infiles+10) {
-    if(strcmp((char*)argv[number_infiles+9], "-float") == 0) {
-      writefloat=1;
-      datatype=LPJ_FLOAT;
-    } else {
-      fprintf(stdout, "\t\tUnknown argument %s\n", argv[number_infiles+9]);
-    }
-  }
-	
-	
-	// ***** LPJmL grid-file *****
-	
-	// open grid-file:
-	grid_file = fopen(path_to_gridfile, "rb");
-	if(grid_file == NULL) {
-		fprintf(stderr, "\t\terror: could not open grid_file %s\n", path_to_gridfile);
-		exit(-1);
-	}
-	
-	// read header of grid_file:  
-	grid_headername = (char *)malloc(7+1); // LPJGRID 
-	grid_header = (Header *)malloc(sizeof(Header));
-	fread(grid_headername, 7, 1, grid_file);
-	fread(grid_header, sizeof(Header), 1, grid_file);
-	
-	if(grid_header->version != 1 && grid_header->version != 2) {
-		if(swapint(grid_header->version) != 1 && swapint(grid_header->version) != 2) {
-			fprintf(stderr, "\t\tinfo: error - cannot determine endian of grid_file\n");
-			fclose(grid_file);
-			exit(-1);
-		}
-		else{
-			swap_grid = 1;
-			grid_header->version = swapint(grid_header->version);
-			grid_header->order = swapint(grid_header->order);
-			grid_header->firstyear = swapint(grid_header->firstyear);
-			grid_header->nyear = swapint(grid_header->nyear);
-			grid_header->firstcell = swapint(grid_header->firstcell);
-			grid_header->ncell = swapint(grid_header->ncell);
-			grid_header->nband = swapint(grid_header->nband);
-			grid_header->cellsize = swapfloat(grid_header->cellsize);
-			grid_header->scalar = swapfloat(grid_header->scalar);
-		}
-	}
-	ncells = grid_header->ncell;
-	
-	fprintf(stdout,"\t\t###############################\n");
-	fprintf(stdout, "\t\t* number of infiles: %d\n", number_infiles);
-	fprintf(stdout, "\t\t* var: %s\n", var);
-	fprintf(stdout, "\t\t* firstyear: %d\n", firstyear);
-	fprintf(stdout, "\t\t* path to gridfile: %s (ncells=%d)\n",path_to_gridfile, ncells);
-	fprintf(stdout, "\t\t* offset (add): %f\n", offset);
-	fprintf(stdout, "\t\t* convert units (mult): %f\n", convert);
-	fprintf(stdout, "\t\t* scalar factor applied when read into LPJ (no change): %f\n", scalar);
-	fprintf(stdout, "\t\t* path to outfile: %s\n\n",path_to_outfile);
-  if(writefloat) {
-    fprintf(stdout, "\t\t* outfile will be created as CLM type 3 with data type LPJ_FLOAT\n");
-  }
-  if(convert==0.0) {
-    fprintf(stdout,"\t\t* Warning: You have set convert to 0.0 which will set all values to zero in CLM file.\n");
-  }
-  if(scalar==0.0) {
-    fprintf(stdout,"\t\t* Warning: You have set scalar to 0.0 which will prompt LPJmL to multiply all CLM file values by zero when reading.\n");
-  }
-	
-	// read grid-data:
-	grid_data = malloc(sizeof(short)*ncells*2);
-	if(grid_data == NULL) {
-		fprintf(stderr, "Error allocating memory for grid_data\n");
-		fclose(grid_file);
-		exit(-1);
-	}
-	fread(grid_data, sizeof(short), ncells*2, grid_file);
-	if(swap_grid == 1)
-		for(cell = 0; cell < ncells*2; cell++)
-			grid_data[cell] = swapshort(grid_data[cell]);
-		
-	ilon = (int*) malloc(sizeof(int)*ncells);
-	ilat = (int*) malloc(sizeof(int)*ncells);
-	if(ilat == NULL) {
-		fprintf(stderr, "Error allocating memory for ilat\n");
-		fclose(grid_file);
-		exit(-1);
-	}
-	if(ilon == NULL) {
-		fprintf(stderr, "Error allocating memory for ilon\n");
-		fclose(grid_file);
-		exit(-1);
-	}
-	
-	/* memory for 1 year of LPJ data */
-	clm_data = (float *)malloc(sizeof(float)*ncells*365); 
-	clm_writedata_short = (short *)malloc(sizeof(short)*ncells*365);
-	if(clm_data == NULL) {
-		fprintf(stderr, "Error allocating memory for clm_data\n");
-		fclose(grid_file);
-		exit(-1);
-	}
-	if(clm_writedata_short == NULL) {
-		fprintf(stderr, "Error allocating memory for clm_writedata_short\n");
-		fclose(grid_file);
-		exit(-1);
-	}
-	
-	// ***** write header of clm-file *****
-	
-	// collect headerdata:
-	clm_header = (Header*)malloc(sizeof(Header));
-  if(writefloat) {
-    clm_header->version = 3;
-  } else {
-    clm_header->version = 2;
-  }
-	clm_header->order = 1;
-	clm_header->firstyear = firstyear;
-	clm_header->nyear = 0;
-	clm_header->firstcell = grid_header->firstcell; 
-	clm_header->ncell = grid_header->ncell;
-	clm_header->nband = 365;
-	clm_header->cellsize = grid_header->cellsize;
-	clm_header->scalar = scalar;
-	
-	
-	// write header to clm-file:
-	clm_file = fopen(path_to_outfile, "wb");
-	if(clm_file == NULL) {
-		fprintf(stderr, "\t\tinfo: could not open clm_file %s\n", clm_file);
-		exit(-1);
-		if(grid_file != NULL)
-			fclose(grid_file);
-	}
-	fwrite("LPJCLIM", 7, 1, clm_file);
-	fwrite(clm_header, sizeof(Header),1,clm_file);
-  if(writefloat) {
-    fwrite(&clm_header->cellsize, sizeof(float),1,clm_file); // assume cellsize_lat==cellsize_lon
-    fwrite(&datatype, sizeof(int),1,clm_file);
-  }
-
-    
-	
-	/***** start of "file"-loop (to combine the different NetCDF-files) ****
-	 ***********************************************************************/
-	
-	for (file=0; file<number_infiles; file++) {
-  	filename_mentioned=0;
-		// some information:
-		fprintf(stdout, "\n\t\tread %d. NetCDF  ...\n",file+1);
-		//fprintf(stdout, "\t\t***************\n\n");
-		fprintf(stdout, "\t\tuse data from: %s\n",argv[file+2]);
-		
-		// open connection to NetCDF:
-		status = nc_open(argv[file+2], 0, &ncid);          
-		if(status != NC_NOERR) {
-			/* could not open input file. Abort completely. */
-			fprintf(stdout, "\t\tError no.%d: %s\n",status, nc_strerror(status));
-			fprintf(stderr, "Error opening %s. Aborting.\n", argv[file+2]);
-			file_error=-1;
-			break;
-		}
-		
-		// ***** get parameter of NetCDF *****
-		// variable:
-		status = nc_inq_varid(ncid,argv[number_infiles+2],&var_id);
-		if(status != NC_NOERR){
-			/* could not find variable */
-			fprintf(stdout, "\t\tError no.%d: %s\n", status, nc_strerror(status));
-			fprintf(stderr, "Error finding variable %s in inputfile. Aborting.\n", argv[number_infiles+2]);
-			file_error=-1;
-			break;
-		}
-		
-		// get Fill-value:
-		status = (int)nc_get_att_float(ncid, var_id, "_FillValue", &fill_value);
-    if(status != NC_NOERR) {
-      /* no _FillValue found, try missing_value */
-      fprintf(stdout,"\t\tError no.%d: %s\n", status, nc_strerror(status));
-      fprintf(stdout,"\t\tNo _FillValue attribute, checking for missing_value attribute\n");
-      status = (int)nc_get_att_float(ncid, var_id, "missing_value", &fill_value);
-      if(status != NC_NOERR) {
-        fprintf(stdout,"\t\tError no.%d: %s\n", status, nc_strerror(status));
-        fprintf(stderr,"Error finding either _FillValue or missing_value attribute. Aborting.\n");
-        file_error=-1;
-        break;
-      } else {
-        fprintf(stdout,"\t\tUsing missing_value attribute instead of _FillValue attribute.\n");
-      }
-    }
-		
-		// time:
-		status = nc_inq_dimid(ncid,"time", &time_id);
-    if(status != NC_NOERR) {
-      /* no time dimension */
-      fprintf(stdout,"\t\tError no.%d: %s\n", status, nc_strerror(status));
-      fprintf(stderr,"Error finding time dimension in inputfile. Aborting.\n");
-      file_error=-1;
-      break;
-    }
-		status = nc_inq_dimlen(ncid, time_id, &time_len);
-		number_yr = (int) (time_len/365);
-		
-		// latitude:   
-		status = nc_inq_dimid(ncid,"lat",&lat_id);
-    if(status != NC_NOERR) {
-      /* no time dimension */
-      fprintf(stdout,"\t\tError no.%d: %s\n", status, nc_strerror(status));
-      fprintf(stderr,"Error finding lat dimension in inputfile. Aborting.\n");
-      file_error=-1;
-      break;
-    }
-		status = nc_inq_dimlen(ncid, lat_id, &latlen);
-		nclat = (double*)malloc(sizeof(double)*latlen);
-		if(nclat == NULL) {
-			fprintf(stderr, "Error allocating memory for nclat\n");
-			memory_error=-1;
-			break;
-		}
-		status = (int) nc_inq_varid(ncid,"lat",&lat_id);
-		status = (int) nc_get_var_double(ncid, lat_id, nclat);
-		
-		// longitude:
-		status = nc_inq_dimid(ncid,"lon",&lon_id);
-    if(status != NC_NOERR) {
-      /* no time dimension */
-      fprintf(stdout,"\t\tError no.%d: %s\n", status, nc_strerror(status));
-      fprintf(stderr,"Error finding lon dimension in inputfile. Aborting.\n");
-      file_error=-1;
-      break;
-    }
-		status = nc_inq_dimlen(ncid, lon_id, &lonlen);
-		nclon = (double*)malloc(sizeof(double)*lonlen);  
-		if(nclon == NULL) {
-			fprintf(stderr, "Error allocating memory for nclon\n");
-			memory_error=-1;
-			break;
-		}
-		status = (int) nc_inq_varid(ncid,"lon",&lon_id);
-		status = (int) nc_get_var_double(ncid, lon_id, nclon);
-		
-		/***** write ilat and ilon *****/
-		for(cell=0; cell<ncells; cell++){
-			ilon[cell] = -999;
-			ilat[cell] = -999;
-			for(column=0; column<lonlen; column++) {
-				if(is_equal((grid_data[cell*2]*grid_header->scalar),nclon[column]))
-					ilon[cell] = column;
-			}
-			for(row = 0; row<latlen; row++){
-				if(is_equal((grid_data[cell*2+1]*grid_header->scalar),nclat[row]))
-					ilat[cell] = row;
-			}
-			if(is_equal(ilat[cell], -999) || is_equal(ilon[cell], -999)) {
-				fprintf(stderr, "Error finding cell %d (%.2f E %.2f N) in NetCDF. Aborting.\n", cell, grid_data[cell*2]*grid_header->scalar, grid_data[cell*2+1]*grid_header->scalar);
-				grid_error = -1;
-			}
-		}
-		if(grid_error) {
-			/* stop processing this and any following files */
-			break;
-		}
-		
-		
-		// ***** start of "year"-loop *****
-		
-		// allocate memory for nc_data for one year:
-		nc_data = (float*)malloc(sizeof(float)*lonlen*latlen*366);
-		if(nc_data == NULL) {
-			fprintf(stderr, "Error allocating memory for nc_data");
-			memory_error = -1;
-			break;
-		}
-		
-		start[0] = (size_t) 0;
-		for(year=0; year<number_yr; year++) {
-			fprintf(stdout, "\t\t *** calculate year %d\n",firstyear+year);
-			fieldmin=SHRT_MAX;
-			fieldmax=SHRT_MIN;
-      if(writefloat) {
-        fieldmin=1e30;
-        fieldmax=-1e30;
-      }
-			for(cell=0; cell < ncells*365; cell++) {
-				clm_data[cell] = 0.0;
-				clm_writedata_short[cell] = 0;
-			}
-			for(cell=0; cell < lonlen*latlen*366; cell++)
-				nc_data[cell] = 0.0;
-			
-			// identify leap_year and "time_len":
-			if( ((firstyear+year)%4 == 0) && ((firstyear+year)%100 != 0) || ((firstyear+year)%400 == 0) ) {
-				leap_yr = 1;
-				fprintf(stdout, "\t\t *** (leap year)\n");
-				time_len = 366;
-			} else {
-				leap_yr = 0;
-				time_len = 365;
-			}
-			
-			// define start and number of reading values:
-			start[1] = 0; // lat
-			start[2] = 0; // lon
-			count[0] = (size_t) time_len;
-			count[1] = (size_t) latlen; 
-			count[2] = (size_t) lonlen;
-			
-			// read values in nc_data:
-			status = (int) nc_get_vara_float(ncid, var_id, start, count, nc_data);
-			
-			// ***** process values of NetCDF and write clm-file *****
-			for(cell=0; cell<ncells; cell++){
-				clm_day = 0;
-				for(day=0; day<time_len; day++){
-					if( leap_yr == 1 && day == 59 && (strcmp(var,"pr") != 0 && strcmp(var,"prsn") != 0 && strcmp(var, "prec") != 0) ) continue;
-					if(cell==0 && leap_yr == 1 && day == 59)
-						fprintf(stdout, "\t\tdistribute leapday values in february\n");
-					
-					// determine indices of NetCDF and clm-file: 
-					nc_index = day*latlen*lonlen + ilat[cell]*lonlen + ilon[cell];
-					clm_index = cell * 365 + clm_day;
-					
-					//test for fill-values and NaN
-					if( is_equal(nc_data[nc_index], fill_value) ) {
-						if(!filename_mentioned) {
-							fprintf(stderr, "File: %s\n", argv[file+2]);
-							filename_mentioned=1;
-						}
-						fprintf(stderr, "Fill-value found in nc_data (cell: %d (%.2f°, %.2f°), day: %d, year: %d)\n",cell, grid_data[cell*2]*grid_header->scalar, grid_data[cell*2+1]*grid_header->scalar, day, firstyear+year);
-						fill_error+=1;
-						//return 1;
-					} else if(isnan(nc_data[nc_index])) {
-						if(!filename_mentioned) {
-							fprintf(stderr, "File: %s\n", argv[file+2]);
-							filename_mentioned=1;
-						}
-						fprintf(stderr, "NaN found in nc_data (cell: %d (%.2f°, %.2f°), day: %d, year: %d)\n",cell, grid_data[cell*2]*grid_header->scalar, grid_data[cell*2+1]*grid_header->scalar, day, firstyear+year);
-						fill_error+=1;
-						//return 1;
-					}
-					
-					// convert values (considering leap-year):
-					clm_data[clm_index] = (nc_data[nc_index] + offset)*convert;
-					if(leap_yr == 0 || day != 59) clm_day++;
-					if(leap_yr == 1 && day == 59 && !is_equal(nc_data[nc_index], fill_value)) {
-						for(febday=31; febday<59; febday++) 
-							clm_data[cell*365+febday] += (nc_data[nc_index]/28+offset)*convert;
-					}
-					
-					// Test: are nc-data in range of short-type:
-					if( ((nc_data[nc_index] + offset)*convert < SHRT_MIN || (nc_data[nc_index] + offset)*convert > SHRT_MAX) && !is_equal(nc_data[nc_index], fill_value) && writefloat==0){
-						if(!filename_mentioned) {
-							fprintf(stderr, "File: %s\n", argv[file+2]);
-							filename_mentioned=1;
-						}
-						fprintf(stderr, "clm_data values out of range of short-type (lon %i (%.2f°), lat %i (%.2f°), cell: %d, day: %d, year: %d, converted clm-value: %f)\n", ilon[cell], grid_data[cell*2]*grid_header->scalar, ilat[cell], grid_data[cell*2+1]*grid_header->scalar , cell, day, firstyear+year, (nc_data[nc_index] + offset)*convert);
-						range_error += 1;
-						//return 1;
-					}
-					
-				} // end of day-loop
-				
-			} // end of cell-loop
-			
-			/* prepare "writedata": */
-			for(cell=0; cell < ncells*365; cell++) {
-				clm_writedata_short[cell] = (short)roundf(clm_data[cell]);
-				if(clm_data[cell] < fieldmin)
-					fieldmin=clm_data[cell];
-				if(clm_data[cell] > fieldmax)
-					fieldmax=clm_data[cell];
-			} // end of cell-loop
-			if(fieldmax*scalar > 1e-1)
-  			fprintf(stdout, "\t\tData range in field: %.2f - %.2f\n", writefloat ? fieldmin*scalar : roundf(fieldmin)*scalar, writefloat ? fieldmax*scalar : roundf(fieldmax)*scalar);
-  		else if(fieldmax*scalar > 1e-3)
-  			fprintf(stdout, "\t\tData range in field: %.4f - %.4f\n", writefloat ? fieldmin*scalar : roundf(fieldmin)*scalar, writefloat ? fieldmax*scalar : roundf(fieldmax)*scalar);
-  		else
-  			fprintf(stdout, "\t\tData range in field: %.8f - %.8f\n", writefloat ? fieldmin*scalar : roundf(fieldmin)*scalar, writefloat ? fieldmax*scalar : roundf(fieldmax)*scalar);
-			
-			// write clm-file:
-      if(writefloat) {
-        fwrite(clm_data, sizeof(float), ncells*365, clm_file);
-      } else {
-        fwrite(clm_writedata_short, sizeof(short), ncells*365, clm_file);
-      }
-			start[0] += (size_t) time_len;   
-			
-		} // end of "year"-loop
-		
-		// update firstyear of next NetCDF-file and count all years in clm-file:
-		firstyear+=number_yr;
-		all_years +=number_yr;
-		
-		// close file and free allocated memory:
-		status = nc_close(ncid);
-		free(nclon);
-		free(nclat);
-		free(nc_data);
-		
-		fprintf(stdout, "\t\t( current NetCDF done )\n");
-	} // end of "file"-loop
-	
-	// rewrite nyears in clm-header:
-	clm_header->nyear = all_years;
-	fseek(clm_file, 7 ,SEEK_SET);
-	fwrite(clm_header, sizeof(Header),1,clm_file);
-	
-	fclose(clm_file);
-	fclose(grid_file);
-	
-	free(grid_header);
-	free(grid_headername);
-	free(clm_header);
-	free(clm_data);
-	free(clm_writedata_short);
-	free(grid_data);
-	free(ilon);
-	free(ilat);
-	if(grid_error) {
-		fprintf(stdout, "\t\tProgram aborted prematurely because of grid error\n");
-		fprintf(stderr, "Program aborted prematurely because of grid error\n");
-	}
-	if(file_error) {
-		fprintf(stderr, "Program aborted prematurely because of NetCDF file error\n");
-		fprintf(stdout, "\t\tProgram aborted prematurely because of NetCDF file error\n");
-	}
-	if(fill_error)
-		fprintf(stdout, "\t\tProgram encountered %ld NAN or missing values.\n", fill_error);
-	if(range_error)
-		fprintf(stdout, "\t\tProgram encountered %ld values out of SHORT range, not incl. possible NAN or missing values\n", range_error);
-	fprintf(stdout, "\t\t( end of program )\n\n");
-	
-	if(grid_error)
-		return grid_error;
-	if(file_error)
-		return file_error;
-	if(fill_error || range_error)
-		return -1;
-	return 0;
-}
-
+/*
+ * isimip_nc2clm_v2.c
+ *
+ *  Created from isimip_nc2clm: May 19, 2020
+ *                          by: ostberg
+ *  The version allows the creation of CLM3 files with data type LPJ_FLOAT
+ *  Use the new optional command line argument -float for this
+ *  Some additional changes compared to its predecessor including how to
+ *  print error messages, how to print ranges for very small values and
+ *  recognizing "prec" as precipitation in addition to "pr" and "prsn"
+ *  Optional command line argument -threads N splits the cell loop across N
+ *  threads; output is identical to the serial run
+ *  Optional command line argument -sparse reads only the parts of the NetCDF
+ *  grid that contain cells of the LPJmL grid instead of the global field
+ *  Optional command line argument -pipeline N reads, converts and writes
+ *  consecutive years concurrently using N year buffers
+ *  Cells of the grid file are located in the NetCDF coordinates by index
+ *  instead of linear search; the mapping is reused for files with the same
+ *  coordinates and can be cached on disk with -mapcache DIR
+ *  Optional command line argument -derive computes a derived variable like
+ *  lwnet from two sets of input files read in lockstep
+ *  Optional command line argument -spec converts several variables listed in
+ *  a spec file in one run
+ *  Values of blocks of cells are gathered into cache-resident tiles before
+ *  conversion, cell by cell if the cells are in the order of the input and
+ *  in tiles of days otherwise (see nc2clm_kernels.h)
+ *  Values are converted by vectorized kernels selected at runtime (AVX2,
+ *  SSE4.1 or portable), which can be chosen with -kernel NAME
+ *  The handling of leap days is set with -leapday instead of depending on
+ *  the variable name only; -nofillcheck skips the check for fill values
+ *  Optional command line arguments -chunk DAYS and -max-mem MB read NetCDF
+ *  data in chunks of days gathered into the year buffers to bound memory
+ *  For chunked (compressed) input the chunk cache is sized to the chunks
+ *  holding grid cells (within -max-mem) and reads end at chunk boundaries of
+ *  the time dimension
+ *  The header is updated after each year written; -resume appends the
+ *  missing years to an interrupted output file
+ *  Optional command line argument -files N converts N input files at the
+ *  same time in separate processes writing to their part of the output file
+ *  Optional command line argument -output selects how the output file is
+ *  written: buffered stdio, preallocated with large aligned writes or mmap
+ *  Optional command line argument -timing prints the time of each stage,
+ *  used by bench_nc2clm.sh
+ *  Messages about single values are limited by -max-messages N, all values
+ *  are counted per year and per cell; -metrics FILE writes a JSON report
+ *  Compiled with -DUSE_MPI, optional command line argument -mpi cells|years
+ *  splits the cells or the input files between MPI ranks, which write their
+ *  part of the output file; rank 0 writes the header
+ *  Optional command line argument -netcdf writes a chunked and compressed
+ *  NetCDF-4 copy of each CLM file, see -nc-chunk, -nc-deflate, -nc-noshuffle
+ *  Optional command line argument -quantize cell|year stores float values as
+ *  16 bit integers with offset and scale of each cell and year or of each
+ *  year in a separate CLM file (.factors.clm) and reports the largest error
+ *  Optional command line arguments -startyear and -endyear convert only the
+ *  time steps of these years, files of consecutive years are joined by
+ *  clmmerge
+ *  Optional command line arguments -monthly and -annual write sums, means,
+ *  minima or maxima of each cell and month or year of the converted values
+ *  to further CLM files in the same pass
+ */
+/* compile on cluster e.g:
+ * module load netcdf-c/4.6.1/intel/serial
+ * module load intel/2019.5
+ * icc -O3 -xCORE-AVX2 -no-vec -pthread isimip_nc2clm_v2.c -o isimip_nc2clm_v2 -B $NETCDF_CROOT -B $NETCDF_CROOT/lib -lnetcdf -lm
+ * with MPI e.g.:
+ * mpicc -O3 -DUSE_MPI -pthread isimip_nc2clm_v2.c -o isimip_nc2clm_v2_mpi -lnetcdf -lm
+ * mpirun -np 4 ./isimip_nc2clm_v2_mpi ... -mpi cells
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <netcdf.h>
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <limits.h>
+#include <float.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include "nc2clm_kernels.h"
+#ifdef USE_MPI
+#include <mpi.h>
+#if defined(NC_HAS_PARALLEL) && NC_HAS_PARALLEL
+#include <netcdf_par.h>
+#define NC_PARALLEL // NetCDF files can be opened by all MPI ranks together
+#endif
+#endif
+#define is_equal(a, b) (fabs((a) - (b)) < 0.0001)
+/* make sure that these correspond to values defined in types.h of LPJmL */
+#define LPJ_FLOAT 3
+#define LPJ_SHORT 1
+
+
+typedef struct {
+	int version, order, firstyear, nyear, firstcell, ncell, nband;
+	float cellsize, scalar;
+} Header; // cellsize = float
+
+// ***** swap-functions *****
+static void swap(char *a,char *b){
+	char h;
+	h=*a;
+	*a=*b;
+	*b=h;
+}
+
+short int swapshort(short int x){
+	swap((char *)&x,(char *)(&x)+1);
+	return x;
+}
+
+int swapint(int x){
+	swap((char *)&x,(char *)(&x)+3);
+	swap((char *)&x+1,(char *)(&x)+2);
+	return x;
+} 
+
+static float swapfloat(int num)
+{
+	float ret;
+	num=swapint(num);
+	memcpy(&ret,&num,sizeof(int));
+	return ret;
+} // of 'swapfloat'
+
+static double wallclock(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// ***** MPI ranks, a single rank without MPI *****
+static int mpi_rank = 0, mpi_size = 1;
+static int nc_parallel = 0; // NetCDF files are opened by all ranks together
+
+/* returns 1 if ok is set on all ranks */
+static int all_ranks(int ok) {
+#ifdef USE_MPI
+	if(mpi_size > 1)
+		MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+#endif
+	return ok;
+}
+
+static void wait_ranks(void) {
+#ifdef USE_MPI
+	if(mpi_size > 1)
+		MPI_Barrier(MPI_COMM_WORLD);
+#endif
+}
+
+// ***** NetCDF input file *****
+#define NCFILE_FILE_ERROR -1
+#define NCFILE_MEMORY_ERROR -2
+
+typedef struct {
+	int ncid, var_id;
+	float fill_value;
+	size_t time_len, latlen, lonlen; // length of variables in NetCDF
+	double *nclat, *nclon;
+	size_t chunk[3]; // chunk of variable (time, lat, lon), 0 if stored contiguous
+	int shuffle, deflate; // deflate level, 0 if not compressed
+} Ncfile;
+
+/* opens NetCDF file and reads parameters of variable var, returns 0 on success */
+static int open_ncfile(const char *filename, const char *var, Ncfile *nc) {
+	int status, lat_id, lon_id, time_id, storage, deflate;
+	nc->nclat = nc->nclon = NULL;
+#ifdef NC_PARALLEL
+	if(nc_parallel)
+		status = nc_open_par(filename, NC_NOWRITE, MPI_COMM_WORLD, MPI_INFO_NULL, &nc->ncid);
+	else
+#endif
+	status = nc_open(filename, 0, &nc->ncid);
+	if(status != NC_NOERR) {
+		/* could not open input file. Abort completely. */
+		fprintf(stdout, "\t\tError no.%d: %s\n",status, nc_strerror(status));
+		fprintf(stderr, "Error opening %s. Aborting.\n", filename);
+		return NCFILE_FILE_ERROR;
+	}
+	
+	// variable:
+	status = nc_inq_varid(nc->ncid, var, &nc->var_id);
+	if(status != NC_NOERR){
+		/* could not find variable */
+		fprintf(stdout, "\t\tError no.%d: %s\n", status, nc_strerror(status));
+		fprintf(stderr, "Error finding variable %s in inputfile. Aborting.\n", var);
+		nc_close(nc->ncid);
+		return NCFILE_FILE_ERROR;
+	}
+	
+	// chunks and compression of variable:
+	if(nc_inq_var_chunking(nc->ncid, nc->var_id, &storage, nc->chunk) != NC_NOERR || storage != NC_CHUNKED)
+		nc->chunk[0] = nc->chunk[1] = nc->chunk[2] = 0;
+	if(nc_inq_var_deflate(nc->ncid, nc->var_id, &nc->shuffle, &deflate, &nc->deflate) != NC_NOERR || !deflate)
+		nc->shuffle = nc->deflate = 0;
+	
+	// get Fill-value:
+	status = (int)nc_get_att_float(nc->ncid, nc->var_id, "_FillValue", &nc->fill_value);
+  if(status != NC_NOERR) {
+    /* no _FillValue found, try missing_value */
+    fprintf(stdout,"\t\tError no.%d: %s\n", status, nc_strerror(status));
+    fprintf(stdout,"\t\tNo _FillValue attribute, checking for missing_value attribute\n");
+    status = (int)nc_get_att_float(nc->ncid, nc->var_id, "missing_value", &nc->fill_value);
+    if(status != NC_NOERR) {
+      fprintf(stdout,"\t\tError no.%d: %s\n", status, nc_strerror(status));
+      fprintf(stderr,"Error finding either _FillValue or missing_value attribute. Aborting.\n");
+      nc_close(nc->ncid);
+      return NCFILE_FILE_ERROR;
+    } else {
+      fprintf(stdout,"\t\tUsing missing_value attribute instead of _FillValue attribute.\n");
+    }
+  }
+	
+	// time:
+	status = nc_inq_dimid(nc->ncid,"time", &time_id);
+  if(status != NC_NOERR) {
+    /* no time dimension */
+    fprintf(stdout,"\t\tError no.%d: %s\n", status, nc_strerror(status));
+    fprintf(stderr,"Error finding time dimension in inputfile. Aborting.\n");
+    nc_close(nc->ncid);
+    return NCFILE_FILE_ERROR;
+  }
+	status = nc_inq_dimlen(nc->ncid, time_id, &nc->time_len);
+	
+	// latitude:   
+	status = nc_inq_dimid(nc->ncid,"lat",&lat_id);
+  if(status != NC_NOERR) {
+    /* no lat dimension */
+    fprintf(stdout,"\t\tError no.%d: %s\n", status, nc_strerror(status));
+    fprintf(stderr,"Error finding lat dimension in inputfile. Aborting.\n");
+    nc_close(nc->ncid);
+    return NCFILE_FILE_ERROR;
+  }
+	status = nc_inq_dimlen(nc->ncid, lat_id, &nc->latlen);
+	nc->nclat = (double*)malloc(sizeof(double)*nc->latlen);
+	if(nc->nclat == NULL) {
+		fprintf(stderr, "Error allocating memory for nclat\n");
+		nc_close(nc->ncid);
+		return NCFILE_MEMORY_ERROR;
+	}
+	status = (int) nc_inq_varid(nc->ncid,"lat",&lat_id);
+	status = (int) nc_get_var_double(nc->ncid, lat_id, nc->nclat);
+	
+	// longitude:
+	status = nc_inq_dimid(nc->ncid,"lon",&lon_id);
+  if(status != NC_NOERR) {
+    /* no lon dimension */
+    fprintf(stdout,"\t\tError no.%d: %s\n", status, nc_strerror(status));
+    fprintf(stderr,"Error finding lon dimension in inputfile. Aborting.\n");
+    free(nc->nclat);
+    nc_close(nc->ncid);
+    return NCFILE_FILE_ERROR;
+  }
+	status = nc_inq_dimlen(nc->ncid, lon_id, &nc->lonlen);
+	nc->nclon = (double*)malloc(sizeof(double)*nc->lonlen);  
+	if(nc->nclon == NULL) {
+		fprintf(stderr, "Error allocating memory for nclon\n");
+		free(nc->nclat);
+		nc_close(nc->ncid);
+		return NCFILE_MEMORY_ERROR;
+	}
+	status = (int) nc_inq_varid(nc->ncid,"lon",&lon_id);
+	status = (int) nc_get_var_double(nc->ncid, lon_id, nc->nclon);
+	return 0;
+} // of 'open_ncfile'
+
+static void close_ncfile(Ncfile *nc) {
+	nc_close(nc->ncid);
+	free(nc->nclon);
+	free(nc->nclat);
+	nc->nclon = nc->nclat = NULL;
+} // of 'close_ncfile'
+
+// ***** variables derived from two input variables *****
+typedef float (*Derivefunc)(float, float);
+
+static float derive_lwnet(float rlds, float tas) {
+	/* same order of operations as in generate_lwnet_*.sh:
+	 * cdo mulc,5.670373e-8 -mul tas -mul tas -mul tas tas sigmat4
+	 * cdo sub rlds sigmat4 lwnet */
+	double t = tas;
+	float sigmat4 = (float)(t*(t*(t*t))*5.670373e-8);
+	return (float)((double)rlds - sigmat4);
+}
+
+static float derive_mean(float a, float b) {
+	return (float)(((double)a + b)*0.5);
+}
+
+static float derive_sum(float a, float b) {
+	return (float)((double)a + b);
+}
+
+static float derive_diff(float a, float b) {
+	return (float)((double)a - b);
+}
+
+typedef struct {
+	const char *name;
+	Derivefunc func;
+	const char *description;
+} Derivedvar;
+
+static const Derivedvar derivedvars[] = {
+	{"lwnet", derive_lwnet, "var - 5.670373e-8 * var2^4, e.g. lwnet from rlds and tas"},
+	{"mean", derive_mean, "(var + var2) / 2, e.g. tas from tasmax and tasmin"},
+	{"sum", derive_sum, "var + var2"},
+	{"diff", derive_diff, "var - var2"}
+};
+
+static const Derivedvar *find_derivedvar(const char *name) {
+	int i;
+	for(i=0; i<sizeof(derivedvars)/sizeof(derivedvars[0]); i++)
+		if(strcmp(derivedvars[i].name, name) == 0)
+			return &derivedvars[i];
+	return NULL;
+}
+
+static int is_missing(float value, float fill_value) {
+	return is_equal(value, fill_value) || isnan(value);
+}
+
+/* combines n values of a and b into a, missing if any input is missing */
+static void derive_values(const Derivedvar *derived, float *a, const float *b, size_t n, float fill_value, float fill_value2) {
+	size_t i;
+	for(i=0; i<n; i++) {
+		if(is_missing(a[i], fill_value) || is_missing(b[i], fill_value2))
+			a[i] = fill_value;
+		else
+			a[i] = derived->func(a[i], b[i]);
+	}
+} // of 'derive_values'
+
+// ***** mapping of LPJmL cells to NetCDF coordinates *****
+typedef struct {
+	const double *coord;
+	size_t len;
+	int regular; // coordinates are equally spaced, index is computed directly
+	double first, step;
+	size_t *order; // indices of coordinates sorted by value, if not regular
+} Coordindex;
+
+static const double *sort_coord; // coordinates used by 'cmp_coord'
+
+static int cmp_coord(const void *a, const void *b) {
+	double da = sort_coord[*(const size_t *)a], db = sort_coord[*(const size_t *)b];
+	if(da < db)
+		return -1;
+	if(da > db)
+		return 1;
+	return (*(const size_t *)a < *(const size_t *)b) ? -1 : 1;
+}
+
+static int build_coordindex(Coordindex *index, const double *coord, size_t len) {
+	size_t i;
+	index->coord = coord;
+	index->len = len;
+	index->order = NULL;
+	index->first = coord[0];
+	index->step = (len > 1) ? (coord[len-1]-coord[0])/(len-1) : 1;
+	index->regular = (index->step != 0);
+	for(i=1; i<len && index->regular; i++)
+		if(!is_equal(coord[i], index->first+i*index->step))
+			index->regular = 0;
+	if(index->regular)
+		return 0;
+	index->order = (size_t *)malloc(sizeof(size_t)*len);
+	if(index->order == NULL)
+		return -1;
+	for(i=0; i<len; i++)
+		index->order[i] = i;
+	sort_coord = coord;
+	qsort(index->order, len, sizeof(size_t), cmp_coord);
+	return 0;
+} // of 'build_coordindex'
+
+/* returns index of coordinate equal to value or -999 if not found */
+static int find_coord(const Coordindex *index, double value) {
+	long i;
+	size_t lo, hi, mid;
+	int found = -999;
+	if(index->regular) {
+		i = lround((value-index->first)/index->step);
+		if(i >= 0 && i < index->len && is_equal(value, index->coord[i]))
+			return (int)i;
+		return -999;
+	}
+	/* binary search for first coordinate not below value - tolerance */
+	lo = 0;
+	hi = index->len;
+	while(lo < hi) {
+		mid = (lo+hi)/2;
+		if(index->coord[index->order[mid]] <= value-0.0001)
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+	/* like a linear scan, use the last of several matching coordinates */
+	for(; lo<index->len && index->coord[index->order[lo]] < value+0.0001; lo++)
+		if(is_equal(value, index->coord[index->order[lo]]) && (int)index->order[lo] > found)
+			found = (int)index->order[lo];
+	return found;
+} // of 'find_coord'
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size) {
+	/* FNV-1a */
+	const unsigned char *p = (const unsigned char *)data;
+	size_t i;
+	for(i=0; i<size; i++) {
+		hash ^= p[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+#define MAPCACHE_VERSION 1
+
+/* mapping cache files are named by the hash of grid file and NetCDF coordinates */
+static void mapcache_name(char *name, size_t size, const char *dir, uint64_t key) {
+	snprintf(name, size, "%s/isimip_nc2clm_map_%016llx.bin", dir, (unsigned long long)key);
+}
+
+/* returns 0 if mapping was read from cache */
+static int read_mapcache(const char *dir, uint64_t key, int ncells, size_t latlen, size_t lonlen, int *ilat, int *ilon) {
+	char name[FILENAME_MAX], headername[6];
+	FILE *file;
+	int version, n, cell;
+	uint64_t filekey;
+	size_t len[2];
+	mapcache_name(name, sizeof(name), dir, key);
+	file = fopen(name, "rb");
+	if(file == NULL)
+		return -1;
+	if(fread(headername, 6, 1, file) != 1 || memcmp(headername, "LPJMAP", 6) ||
+			fread(&version, sizeof(int), 1, file) != 1 || version != MAPCACHE_VERSION ||
+			fread(&filekey, sizeof(filekey), 1, file) != 1 || filekey != key ||
+			fread(&n, sizeof(int), 1, file) != 1 || n != ncells ||
+			fread(len, sizeof(size_t), 2, file) != 2 || len[0] != latlen || len[1] != lonlen ||
+			fread(ilat, sizeof(int), ncells, file) != ncells ||
+			fread(ilon, sizeof(int), ncells, file) != ncells) {
+		fclose(file);
+		return -1;
+	}
+	fclose(file);
+	for(cell=0; cell<ncells; cell++)
+		if(ilat[cell] < 0 || ilat[cell] >= latlen || ilon[cell] < 0 || ilon[cell] >= lonlen)
+			return -1;
+	return 0;
+} // of 'read_mapcache'
+
+static void write_mapcache(const char *dir, uint64_t key, int ncells, size_t latlen, size_t lonlen, const int *ilat, const int *ilon) {
+	char name[FILENAME_MAX], tmpname[FILENAME_MAX+32];
+	FILE *file;
+	int version = MAPCACHE_VERSION;
+	size_t len[2];
+	int ok;
+	mapcache_name(name, sizeof(name), dir, key);
+	/* write to temporary file first, concurrent runs may use the same cache */
+	snprintf(tmpname, sizeof(tmpname), "%s.%ld.tmp", name, (long)getpid());
+	file = fopen(tmpname, "wb");
+	if(file == NULL) {
+		fprintf(stdout, "\t\tWarning: could not write grid mapping cache %s\n", tmpname);
+		return;
+	}
+	len[0] = latlen;
+	len[1] = lonlen;
+	ok = fwrite("LPJMAP", 6, 1, file) == 1 &&
+		fwrite(&version, sizeof(int), 1, file) == 1 &&
+		fwrite(&key, sizeof(key), 1, file) == 1 &&
+		fwrite(&ncells, sizeof(int), 1, file) == 1 &&
+		fwrite(len, sizeof(size_t), 2, file) == 2 &&
+		fwrite(ilat, sizeof(int), ncells, file) == ncells &&
+		fwrite(ilon, sizeof(int), ncells, file) == ncells;
+	if(fclose(file) || !ok || rename(tmpname, name)) {
+		fprintf(stdout, "\t\tWarning: could not write grid mapping cache %s\n", name);
+		remove(tmpname);
+	}
+} // of 'write_mapcache'
+
+// ***** read plan: hyperslabs of the NetCDF grid that contain LPJmL cells *****
+/* maximum number of ocean cells between two land cells in one latitude row
+ * that are read instead of starting a new hyperslab */
+#define PLAN_MAXGAP 8
+
+typedef struct {
+	size_t lat, nlat, lon, nlon; // hyperslab in NetCDF grid
+	size_t offset; // position of first value of segment for one day in compact buffer
+} Segment;
+
+typedef struct {
+	int nseg;
+	Segment *seg;
+	size_t daysize; // number of values read per day
+	size_t ndays; // maximum number of days read at once
+} Readplan;
+
+/* values of segment s are stored in nc_data starting at seg[s].offset*ndays
+ * ordered by day, lat, lon, so index of a cell for a given day is
+ * nc_base[cell] + day*nc_stride[cell] */
+
+static int plan_full(Readplan *plan, size_t latlen, size_t lonlen, const int *ilat, const int *ilon, int ncells, size_t ndays, size_t *nc_base, size_t *nc_stride) {
+	int cell;
+	plan->seg = (Segment *)malloc(sizeof(Segment));
+	if(plan->seg == NULL)
+		return -1;
+	plan->nseg = 1;
+	plan->seg[0].lat = plan->seg[0].lon = plan->seg[0].offset = 0;
+	plan->seg[0].nlat = latlen;
+	plan->seg[0].nlon = lonlen;
+	plan->daysize = latlen*lonlen;
+	plan->ndays = ndays;
+	for(cell=0; cell<ncells; cell++) {
+		nc_base[cell] = ilat[cell]*lonlen + ilon[cell];
+		nc_stride[cell] = plan->daysize;
+	}
+	return 0;
+} // of 'plan_full'
+
+static int plan_sparse(Readplan *plan, size_t latlen, size_t lonlen, const int *ilat, const int *ilon, int ncells, size_t ndays, size_t *nc_base, size_t *nc_stride) {
+	int cell, maxseg;
+	size_t row, column, end, i;
+	int *segmap; // segment index of each NetCDF grid point, -1 if not read
+	Segment *seg;
+
+	segmap = (int *)malloc(sizeof(int)*latlen*lonlen);
+	if(segmap == NULL)
+		return -1;
+	for(i=0; i<latlen*lonlen; i++)
+		segmap[i] = -1;
+	for(cell=0; cell<ncells; cell++)
+		segmap[ilat[cell]*lonlen + ilon[cell]] = -2;
+	maxseg = 16;
+	plan->seg = (Segment *)malloc(sizeof(Segment)*maxseg);
+	if(plan->seg == NULL) {
+		free(segmap);
+		return -1;
+	}
+	plan->nseg = 0;
+	plan->daysize = 0;
+	plan->ndays = ndays;
+	for(row=0; row<latlen; row++) {
+		column = 0;
+		while(column < lonlen) {
+			if(segmap[row*lonlen+column] != -2) {
+				column++;
+				continue;
+			}
+			/* extend run while the next land cell is at most PLAN_MAXGAP away */
+			end = column+1;
+			for(i=end; i<lonlen && i<=end+PLAN_MAXGAP; i++)
+				if(segmap[row*lonlen+i] == -2)
+					end = i+1;
+			if(plan->nseg == maxseg) {
+				maxseg *= 2;
+				seg = (Segment *)realloc(plan->seg, sizeof(Segment)*maxseg);
+				if(seg == NULL) {
+					free(segmap);
+					return -1;
+				}
+				plan->seg = seg;
+			}
+			seg = &plan->seg[plan->nseg];
+			seg->lat = row;
+			seg->nlat = 1;
+			seg->lon = column;
+			seg->nlon = end-column;
+			seg->offset = plan->daysize;
+			plan->daysize += seg->nlon;
+			for(i=column; i<end; i++)
+				segmap[row*lonlen+i] = plan->nseg;
+			plan->nseg++;
+			column = end;
+		}
+	}
+	for(cell=0; cell<ncells; cell++) {
+		seg = &plan->seg[segmap[ilat[cell]*lonlen + ilon[cell]]];
+		nc_base[cell] = seg->offset*ndays + (ilat[cell]-seg->lat)*seg->nlon + (ilon[cell]-seg->lon);
+		nc_stride[cell] = seg->nlat*seg->nlon;
+	}
+	free(segmap);
+	return 0;
+} // of 'plan_sparse'
+
+/* number of chunks of clat x clon grid points holding hyperslabs of plan */
+static size_t plan_chunks(const Readplan *plan, size_t latlen, size_t lonlen, size_t clat, size_t clon) {
+	char *used; // chunks holding values read
+	size_t nlat = (latlen+clat-1)/clat, nlon = (lonlen+clon-1)/clon, lat, lon, nchunks = 0;
+	int s;
+	used = (char *)calloc(nlat*nlon, 1);
+	if(used == NULL)
+		return nlat*nlon;
+	for(s=0; s<plan->nseg; s++)
+		for(lat=plan->seg[s].lat/clat; lat<=(plan->seg[s].lat+plan->seg[s].nlat-1)/clat; lat++)
+			for(lon=plan->seg[s].lon/clon; lon<=(plan->seg[s].lon+plan->seg[s].nlon-1)/clon; lon++)
+				if(!used[lat*nlon+lon]) {
+					used[lat*nlon+lon] = 1;
+					nchunks++;
+				}
+	free(used);
+	return nchunks;
+} // of 'plan_chunks'
+
+static int read_plan(int ncid, int var_id, const Readplan *plan, size_t firstday, size_t ndays, float *nc_data) {
+	int s, status;
+	size_t start[3], count[3];
+	for(s=0; s<plan->nseg; s++) {
+		start[0] = firstday;
+		start[1] = plan->seg[s].lat;
+		start[2] = plan->seg[s].lon;
+		count[0] = ndays;
+		count[1] = plan->seg[s].nlat;
+		count[2] = plan->seg[s].nlon;
+		status = nc_get_vara_float(ncid, var_id, start, count, nc_data + plan->seg[s].offset*plan->ndays);
+		if(status != NC_NOERR)
+			return status;
+	}
+	return NC_NOERR;
+} // of 'read_plan'
+
+// ***** metrics and diagnostics of one output file *****
+typedef struct {
+	int year; // 0 if year was not converted
+	double read, gather, convert, write; // seconds, gather and convert summed over threads
+	long long read_bytes, write_bytes;
+	long int fill_error, range_error;
+} Yearmetrics;
+
+/* counters are in shared memory to be updated by all processes of -files */
+typedef struct {
+	int max_messages; // detailed messages printed at most, <0 for no limit
+	int *messages; // detailed messages so far including suppressed ones
+	int ncells;
+	int *cell_fill, *cell_range; // values reported for each cell
+	int nyear; // number of years of CLM file in years, 0 if not recorded
+	Yearmetrics *years;
+	size_t size; // size of shared memory, 0 if not initialized
+} Metrics;
+
+/* returns 0 on success */
+static int init_metrics(Metrics *m, int max_messages, int ncells, int nyear) {
+	m->size = sizeof(int)*(1+2*(size_t)ncells) + sizeof(Yearmetrics)*nyear;
+	m->years = (Yearmetrics *)mmap(NULL, m->size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	if(m->years == MAP_FAILED) {
+		m->size = 0;
+		return -1;
+	}
+	/* memory is zeroed */
+	m->messages = (int *)(m->years+nyear);
+	m->cell_fill = m->messages+1;
+	m->cell_range = m->cell_fill+ncells;
+	m->max_messages = max_messages;
+	m->ncells = ncells;
+	m->nyear = nyear;
+	return 0;
+} // of 'init_metrics'
+
+static void free_metrics(Metrics *m) {
+	if(m->size > 0)
+		munmap(m->years, m->size);
+	m->size = 0;
+} // of 'free_metrics'
+
+/* returns metrics of year of CLM file or NULL if years are not recorded */
+static Yearmetrics *year_metrics(const Metrics *m, int year) {
+	return (year >= 0 && year < m->nyear) ? &m->years[year] : NULL;
+}
+
+/* counts a detailed message, returns 1 if it is to be printed */
+static int allow_message(const Metrics *m) {
+	int n = __sync_fetch_and_add(m->messages, 1);
+	return m->max_messages < 0 || n < m->max_messages;
+}
+
+static int suppressed_messages(const Metrics *m) {
+	if(m->size == 0 || m->max_messages < 0 || *m->messages <= m->max_messages)
+		return 0;
+	return *m->messages-m->max_messages;
+}
+
+// ***** conversion of a range of cells for one year *****
+#define LEAPDAY_DROP 0
+#define LEAPDAY_REDISTRIBUTE 1 // distribute value of leap day over february
+
+typedef struct Convertjob Convertjob;
+
+/* converts the values of one cell for one year, see 'convert_cells' */
+typedef void (*Rowfunc)(const Convertjob *job, const float *values, float *clm, short *clm_short, Kernelstats *st);
+
+struct Convertjob {
+	int firstcell, lastcell; // range of cells [firstcell, lastcell) processed by one thread
+	int cell0; // number of first cell in grid file, see 'Grid'
+	int year; // absolute year
+	int leap_yr;
+	size_t time_len;
+	const float *nc_data; // NULL if clm_data holds values read in streaming mode
+	const size_t *nc_base, *nc_stride; // position of cell in nc_data, see 'Readplan'
+	Gatherfunc gather; // gather for the order of the cells, see 'select_gather'
+	const float *leapval; // values of leap day read in streaming mode
+	float *clm_data;
+	short *clm_writedata_short;
+	const int *ilon, *ilat;
+	const short *grid_data;
+	float grid_scalar;
+	const char *filename;
+	float offset, convert, fill_value;
+	int writefloat;
+	int quantize; // QUANTIZE_NONE, QUANTIZE_CELL or QUANTIZE_YEAR
+	float missing; // converted fill value, stored as QUANTIZE_MISSING
+	float *qtab; // offset and scale of each cell with QUANTIZE_CELL
+	int aggregates; // aggregate outputs, see 'aggregate_row'
+	float *const *aggr; // values of aggregate outputs of each cell
+	int leapday, checkfill;
+	/* kernel variants chosen once for the variable and the year */
+	Convertfunc convert_values;
+	Finishfunc finish_values;
+	Rowfunc convert_row;
+	Kernelparam param;
+	short *filename_mentioned;
+	const Metrics *metrics; // limit of messages and counters of each cell
+	/* results, reduced over all threads after each year */
+	long int fill_error, range_error;
+	float fieldmin, fieldmax;
+	float qmin, qmax; // range of values without missing values with QUANTIZE_YEAR
+	float qerror; // largest quantization error with QUANTIZE_CELL
+	double gather_time, convert_time; // seconds spent gathering and converting values
+};
+
+static pthread_mutex_t stderr_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void mention_filename(Convertjob *job) {
+	/* print name of input file only once before the first error message */
+	pthread_mutex_lock(&stderr_mutex);
+	if(!*job->filename_mentioned) {
+		fprintf(stderr, "File: %s\n", job->filename);
+		*job->filename_mentioned=1;
+	}
+	pthread_mutex_unlock(&stderr_mutex);
+}
+
+/* prints and counts fill values, NaN and values out of range of one cell, see 'convert_cells' */
+static void report_cell(Convertjob *job, int cell, const float *values) {
+	int day, nfill = 0, nrange = 0;
+	for(day=0; day<job->time_len; day++){
+		if( job->leap_yr == 1 && day == 59 && job->leapday == LEAPDAY_DROP ) continue;
+
+		//test for fill-values and NaN
+		if( !job->checkfill ) {
+			/* fill values and NaN are converted without notice */
+		} else if( is_equal(values[day], job->fill_value) ) {
+			if(allow_message(job->metrics)) {
+				mention_filename(job);
+				fprintf(stderr, "Fill-value found in nc_data (cell: %d (%.2f°, %.2f°), day: %d, year: %d)\n",job->cell0+cell, job->grid_data[cell*2]*job->grid_scalar, job->grid_data[cell*2+1]*job->grid_scalar, day, job->year);
+			}
+			nfill++;
+		} else if(isnan(values[day])) {
+			if(allow_message(job->metrics)) {
+				mention_filename(job);
+				fprintf(stderr, "NaN found in nc_data (cell: %d (%.2f°, %.2f°), day: %d, year: %d)\n",job->cell0+cell, job->grid_data[cell*2]*job->grid_scalar, job->grid_data[cell*2+1]*job->grid_scalar, day, job->year);
+			}
+			nfill++;
+		}
+
+		// Test: are nc-data in range of short-type:
+		if( ((values[day] + job->offset)*job->convert < SHRT_MIN || (values[day] + job->offset)*job->convert > SHRT_MAX) && !is_equal(values[day], job->fill_value) && job->writefloat==0){
+			if(allow_message(job->metrics)) {
+				mention_filename(job);
+				fprintf(stderr, "clm_data values out of range of short-type (lon %i (%.2f°), lat %i (%.2f°), cell: %d, day: %d, year: %d, converted clm-value: %f)\n", job->ilon[cell], job->grid_data[cell*2]*job->grid_scalar, job->ilat[cell], job->grid_data[cell*2+1]*job->grid_scalar , job->cell0+cell, day, job->year, (values[day] + job->offset)*job->convert);
+			}
+			nrange++;
+		}
+	} // end of day-loop
+	job->fill_error += nfill;
+	job->range_error += nrange;
+	/* cells of one year are split between threads, but years of -files processes are not */
+	__sync_fetch_and_add(&job->metrics->cell_fill[job->cell0+cell], nfill);
+	__sync_fetch_and_add(&job->metrics->cell_range[job->cell0+cell], nrange);
+} // of 'report_cell'
+
+static void convert_row_noleap(const Convertjob *job, const float *values, float *clm, short *clm_short, Kernelstats *st) {
+	job->convert_values(values, 365, &job->param, 1, clm, clm_short, st);
+}
+
+static void convert_row_drop(const Convertjob *job, const float *values, float *clm, short *clm_short, Kernelstats *st) {
+	job->convert_values(values, 59, &job->param, 1, clm, clm_short, st);
+	job->convert_values(values+60, 306, &job->param, 1, clm+59, clm_short+59, st);
+}
+
+static void convert_row_redistribute(const Convertjob *job, const float *values, float *clm, short *clm_short, Kernelstats *st) {
+	int febday;
+	/* the value of the leap day is checked, then overwritten by the next day */
+	job->convert_values(values, 60, &job->param, 0, clm, clm_short, st);
+	job->convert_values(values+60, 306, &job->param, 0, clm+59, clm_short+59, st);
+	if(!is_equal(values[59], job->fill_value)) {
+		for(febday=31; febday<59; febday++)
+			clm[febday] += (values[59]/28+job->offset)*job->convert;
+	}
+	job->finish_values(clm, 365, clm_short, st);
+}
+
+static const Rowfunc convert_row_leap[] = {convert_row_drop, convert_row_redistribute}; // index is leapday policy
+
+// ***** 16 bit quantization of float values *****
+#define QUANTIZE_NONE 0
+#define QUANTIZE_CELL 1 // offset and scale of each cell and year
+#define QUANTIZE_YEAR 2 // offset and scale of each year
+#define QUANTIZE_MISSING SHRT_MIN // stored for NaN and fill values
+
+static const char *quantize_methods[] = {"none", "cell", "year"};
+
+/* range of n values without NaN and missing values, min > max if there are none */
+static void quantize_range(const float *values, int n, float missing, float *min, float *max) {
+	int i;
+	for(i=0; i<n; i++) {
+		if(values[i] == missing || !isfinite(values[i]))
+			continue;
+		if(values[i] < *min)
+			*min = values[i];
+		if(values[i] > *max)
+			*max = values[i];
+	}
+} // of 'quantize_range'
+
+/* offset and scale mapping [min, max] to [-SHRT_MAX, SHRT_MAX] */
+static void quantize_factors(float min, float max, float *factors) {
+	if(min > max) {
+		factors[0] = factors[1] = 0;
+		return;
+	}
+	factors[0] = min+(max-min)/2;
+	factors[1] = (max-min)/(2*SHRT_MAX);
+} // of 'quantize_factors'
+
+/* stores n values as round((value-offset)/scale), decoded as offset+q*scale;
+ * returns largest difference of decoded and original values */
+static float quantize_values(const float *values, size_t n, float missing, const float *factors, short *q) {
+	size_t i;
+	float inv = (factors[1] > 0) ? 1/factors[1] : 0, x, error = 0;
+	for(i=0; i<n; i++) {
+		if(values[i] == missing || !isfinite(values[i])) {
+			q[i] = QUANTIZE_MISSING;
+			continue;
+		}
+		x = roundf((values[i]-factors[0])*inv);
+		if(x > SHRT_MAX)
+			x = SHRT_MAX;
+		else if(x < -SHRT_MAX)
+			x = -SHRT_MAX;
+		q[i] = (short)x;
+		x = fabsf(factors[0]+q[i]*factors[1]-values[i]);
+		if(x > error)
+			error = x;
+	}
+	return error;
+} // of 'quantize_values'
+
+// ***** monthly and annual aggregates of converted values *****
+#define AGGR_MONTHLY 0
+#define AGGR_ANNUAL 1
+#define AGGR_SUM 0
+#define AGGR_MEAN 1
+#define AGGR_MIN 2
+#define AGGR_MAX 3
+#define NSTATS 4
+#define NAGGR (2*NSTATS) // output period*NSTATS+stat, bit 1<<output is set in aggregates if written
+
+static const char *aggr_periods[] = {"monthly", "annual"};
+static const char *aggr_stats[] = {"sum", "mean", "min", "max"};
+static const int aggr_bands[] = {12, 1};
+static const int month_days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31}; // calendar of CLM files without leap days
+
+/* sum, mean, min and max of each month and of the year of the 365 converted
+ * values of a cell, missing values and NaN are skipped; periods without
+ * values are NaN. Writes the outputs set in aggregates to aggr[output]+cell*bands */
+static void aggregate_row(const float *clm, float missing, int aggregates, float *const *aggr, int cell) {
+	double sum[13];
+	float min[13], max[13], value;
+	int n[13], month, day, first, output, band, period;
+	for(month=0, first=0; month<12; first+=month_days[month++]) {
+		sum[month] = 0;
+		min[month] = INFINITY;
+		max[month] = -INFINITY;
+		n[month] = 0;
+		for(day=first; day<first+month_days[month]; day++) {
+			if(clm[day] == missing || !isfinite(clm[day]))
+				continue;
+			sum[month] += clm[day];
+			if(clm[day] < min[month])
+				min[month] = clm[day];
+			if(clm[day] > max[month])
+				max[month] = clm[day];
+			n[month]++;
+		}
+	}
+	/* year is in index 12 */
+	sum[12] = 0;
+	min[12] = INFINITY;
+	max[12] = -INFINITY;
+	n[12] = 0;
+	for(month=0; month<12; month++) {
+		sum[12] += sum[month];
+		if(min[month] < min[12])
+			min[12] = min[month];
+		if(max[month] > max[12])
+			max[12] = max[month];
+		n[12] += n[month];
+	}
+	for(output=0; output<NAGGR; output++) {
+		if(!(aggregates & (1 << output)))
+			continue;
+		period = output/NSTATS;
+		for(band=0; band<aggr_bands[period]; band++) {
+			month = (period == AGGR_MONTHLY) ? band : 12;
+			if(n[month] == 0)
+				value = NAN;
+			else if(output%NSTATS == AGGR_SUM)
+				value = (float)sum[month];
+			else if(output%NSTATS == AGGR_MEAN)
+				value = (float)(sum[month]/n[month]);
+			else if(output%NSTATS == AGGR_MIN)
+				value = min[month];
+			else
+				value = max[month];
+			aggr[output][(size_t)cell*aggr_bands[period]+band] = value;
+		}
+	}
+} // of 'aggregate_row'
+
+static void convert_cells(Convertjob *job) {
+	int block, nblock, cell;
+	long int nerror;
+	const float *values;
+	float tile[GATHER_CELLS*366]; // values of GATHER_CELLS cells, cell-major
+	const float *clm;
+	float qmin, qmax, qerror;
+	Kernelstats stats;
+	double start;
+
+	job->fill_error=job->range_error = 0;
+	stats.nerror = 0;
+	stats.min=SHRT_MAX;
+	stats.max=SHRT_MIN;
+	if(job->writefloat) {
+		stats.min=1e30;
+		stats.max=-1e30;
+	}
+	if(job->firstcell==0 && job->lastcell>0 && job->leap_yr == 1 && job->leapday == LEAPDAY_REDISTRIBUTE)
+		fprintf(stdout, "\t\tdistribute leapday values in february\n");
+
+	job->qmin = INFINITY;
+	job->qmax = -INFINITY;
+	job->qerror = 0;
+	job->gather_time = job->convert_time = 0;
+	for(block=job->firstcell; block<job->lastcell; block+=GATHER_CELLS) {
+		nblock = (job->lastcell-block < GATHER_CELLS) ? job->lastcell-block : GATHER_CELLS;
+		start = wallclock();
+		if(job->nc_data != NULL) {
+			job->gather(job->nc_data, job->nc_base, job->nc_stride, block, nblock, 0, (int)job->time_len, tile, 366);
+		} else {
+			/* streaming mode: values were already gathered into clm_data, which is overwritten by converted values */
+			for(cell=block; cell<block+nblock; cell++) {
+				values = job->clm_data + (size_t)cell*365;
+				if(job->leap_yr) {
+					memcpy(tile + (size_t)(cell-block)*366, values, sizeof(float)*59);
+					tile[(size_t)(cell-block)*366+59] = job->leapval[cell];
+					memcpy(tile + (size_t)(cell-block)*366+60, values+59, sizeof(float)*306);
+				} else {
+					memcpy(tile + (size_t)(cell-block)*366, values, sizeof(float)*365);
+				}
+			}
+		}
+		job->gather_time += wallclock()-start;
+		start = wallclock();
+		for(cell=block; cell<block+nblock; cell++){
+			values = tile + (size_t)(cell-block)*366;
+			nerror = stats.nerror;
+			job->convert_row(job, values, job->clm_data + (size_t)cell*365, job->clm_writedata_short + (size_t)cell*365, &stats);
+
+			/* rare: report each fill value, NaN or value out of range */
+			if(stats.nerror != nerror)
+				report_cell(job, cell, values);
+			
+			/* converted values are still in cache */
+			clm = job->clm_data + (size_t)cell*365;
+			if(job->quantize == QUANTIZE_CELL) {
+				qmin = INFINITY;
+				qmax = -INFINITY;
+				quantize_range(clm, 365, job->missing, &qmin, &qmax);
+				quantize_factors(qmin, qmax, job->qtab+2*cell);
+				qerror = quantize_values(clm, 365, job->missing, job->qtab+2*cell, job->clm_writedata_short + (size_t)cell*365);
+				if(qerror > job->qerror)
+					job->qerror = qerror;
+			} else if(job->quantize == QUANTIZE_YEAR) {
+				quantize_range(clm, 365, job->missing, &job->qmin, &job->qmax);
+			}
+			if(job->aggregates)
+				aggregate_row(clm, job->missing, job->aggregates, job->aggr, cell);
+
+		} // end of cell-loop
+		job->convert_time += wallclock()-start;
+	} // end of block-loop
+	job->fieldmin = stats.min;
+	job->fieldmax = stats.max;
+} // of 'convert_cells'
+
+// ***** pool of threads converting cells, shared by all years and variables *****
+typedef struct Threadpool Threadpool;
+
+typedef struct {
+	Threadpool *pool;
+	int index;
+} Worker;
+
+struct Threadpool {
+	int nthreads;
+	Convertjob *jobs; // job 0 is run by the calling thread
+	pthread_t *threads;
+	Worker *workers;
+	int generation; // incremented for each new set of jobs
+	int running; // number of workers still converting
+	int shutdown;
+	pthread_mutex_t mutex;
+	pthread_cond_t start, finished;
+};
+
+static void *convert_thread(void *arg) {
+	Worker *worker = (Worker *)arg;
+	Threadpool *pool = worker->pool;
+	int generation = 0;
+	pthread_mutex_lock(&pool->mutex);
+	for(;;) {
+		while(pool->generation == generation && !pool->shutdown)
+			pthread_cond_wait(&pool->start, &pool->mutex);
+		if(pool->shutdown)
+			break;
+		generation = pool->generation;
+		pthread_mutex_unlock(&pool->mutex);
+		convert_cells(&pool->jobs[worker->index]);
+		pthread_mutex_lock(&pool->mutex);
+		if(--pool->running == 0)
+			pthread_cond_signal(&pool->finished);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+} // of 'convert_thread'
+
+/* starts nthreads-1 workers, returns 0 on success */
+static int init_threadpool(Threadpool *pool, int nthreads) {
+	int i;
+	pool->jobs = (Convertjob *)malloc(sizeof(Convertjob)*nthreads);
+	pool->threads = (pthread_t *)malloc(sizeof(pthread_t)*nthreads);
+	pool->workers = (Worker *)malloc(sizeof(Worker)*nthreads);
+	if(pool->jobs == NULL || pool->threads == NULL || pool->workers == NULL)
+		return -1;
+	pool->generation = pool->running = pool->shutdown = 0;
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->finished, NULL);
+	for(i=1; i<nthreads; i++) {
+		pool->workers[i].pool = pool;
+		pool->workers[i].index = i;
+		if(pthread_create(&pool->threads[i], NULL, convert_thread, &pool->workers[i])) {
+			fprintf(stdout, "\t\tWarning: could only start %d threads\n", i);
+			break;
+		}
+	}
+	pool->nthreads = i;
+	return 0;
+} // of 'init_threadpool'
+
+/* runs the jobs of all threads and waits until all are done */
+static void run_threadpool(Threadpool *pool) {
+	pthread_mutex_lock(&pool->mutex);
+	pool->running = pool->nthreads-1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->mutex);
+	convert_cells(&pool->jobs[0]);
+	pthread_mutex_lock(&pool->mutex);
+	while(pool->running > 0)
+		pthread_cond_wait(&pool->finished, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+} // of 'run_threadpool'
+
+static void free_threadpool(Threadpool *pool) {
+	int i;
+	pthread_mutex_lock(&pool->mutex);
+	pool->shutdown = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->mutex);
+	for(i=1; i<pool->nthreads; i++)
+		pthread_join(pool->threads[i], NULL);
+	pthread_mutex_destroy(&pool->mutex);
+	pthread_cond_destroy(&pool->start);
+	pthread_cond_destroy(&pool->finished);
+	free(pool->jobs);
+	free(pool->threads);
+	free(pool->workers);
+} // of 'free_threadpool'
+
+// ***** output of CLM file *****
+#define OUTPUT_STDIO 0 // buffered stdio, years appended
+#define OUTPUT_DIRECT 1 // preallocated file written in large blocks aligned to OUTPUT_BLOCK
+#define OUTPUT_MMAP 2 // preallocated file mapped into memory, years copied in place
+
+#ifndef OUTPUT_BLOCK
+#define OUTPUT_BLOCK (8*1024*1024)
+#endif
+
+static const char *output_methods[] = {"stdio", "direct", "mmap"};
+
+typedef struct {
+	int method;
+	FILE *file; // open with all methods, writes of OUTPUT_STDIO
+	Header *header; // nyear is updated after each year written
+	off_t headersize, yearsize;
+	off_t size; // preallocated size, 0 if not preallocated
+	int positional; // years are written by several processes, header is written on close only
+	int owner; // writes header and sets size of file on close, not set for MPI ranks other than 0
+	off_t sliceoffset; // part of each year written, whole year unless cells are split between MPI ranks
+	size_t slicesize;
+	char *map; // OUTPUT_MMAP: mapping of whole file
+	char *block; // OUTPUT_DIRECT: data from blockstart not yet written
+	off_t blockstart;
+	size_t blocklen;
+	long long bytes; // bytes of years written
+	double seconds; // time spent writing
+} Outfile;
+
+/* writes size bytes at offset of fd, returns 0 on success */
+static int write_at(int fd, const void *data, size_t size, off_t offset) {
+	ssize_t n;
+	while(size > 0) {
+		n = pwrite(fd, data, size, offset);
+		if(n <= 0)
+			return -1;
+		data = (const char *)data+n;
+		size -= n;
+		offset += n;
+	}
+	return 0;
+} // of 'write_at'
+
+/* file holds header already, returns 0 on success */
+static int init_outfile(Outfile *out, int method, FILE *file, Header *header, int datatype) {
+	out->method = method;
+	out->file = file;
+	out->header = header;
+	out->headersize = 7+sizeof(Header) + ((header->version == 3) ? sizeof(float)+sizeof(int) : 0);
+	out->yearsize = (off_t)header->ncell*header->nband*((datatype == LPJ_FLOAT) ? sizeof(float) : sizeof(short));
+	out->size = 0;
+	out->positional = 0;
+	out->owner = 1;
+	out->sliceoffset = 0;
+	out->slicesize = out->yearsize;
+	out->map = NULL;
+	out->block = NULL;
+	out->blocklen = 0;
+	out->bytes = 0;
+	out->seconds = 0;
+	if(method == OUTPUT_DIRECT && posix_memalign((void **)&out->block, 4096, OUTPUT_BLOCK))
+		return -1;
+	return 0;
+} // of 'init_outfile'
+
+/* sets size of file to hold nyear years and maps it with OUTPUT_MMAP, returns 0 on success */
+static int preallocate_outfile(Outfile *out, int nyear) {
+	int fd = fileno(out->file);
+	double start = wallclock();
+	fflush(out->file);
+	out->size = out->headersize+nyear*out->yearsize;
+	/* not all file systems support fallocate */
+	if(posix_fallocate(fd, 0, out->size) && ftruncate(fd, out->size))
+		return -1;
+	if(out->method == OUTPUT_MMAP) {
+		out->map = (char *)mmap(NULL, out->size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+		if(out->map == MAP_FAILED) {
+			out->map = NULL;
+			return -1;
+		}
+	}
+	out->seconds += wallclock()-start;
+	return 0;
+} // of 'preallocate_outfile'
+
+/* writes data of OUTPUT_DIRECT not yet written, returns 0 on success */
+static int flush_outfile(Outfile *out) {
+	Header header;
+	if(out->blocklen == 0)
+		return 0;
+	if(write_at(fileno(out->file), out->block, out->blocklen, out->blockstart))
+		return -1;
+	out->blockstart += out->blocklen;
+	out->blocklen = 0;
+	if(out->positional)
+		return 0;
+	/* header counts only complete years in file */
+	header = *out->header;
+	header.nyear = (int)((out->blockstart-out->headersize)/out->yearsize);
+	return write_at(fileno(out->file), &header, sizeof(Header), 7);
+} // of 'flush_outfile'
+
+/* writes year of CLM file, returns 0 on success */
+static int write_outfile(Outfile *out, int year, const void *data) {
+	off_t pos = out->headersize+year*out->yearsize+out->sliceoffset;
+	size_t n, done;
+	int status = 0;
+	double start = wallclock();
+	if(out->method == OUTPUT_MMAP) {
+		memcpy(out->map+pos, data, out->slicesize);
+		if(!out->positional) {
+			out->header->nyear++;
+			memcpy(out->map+7, out->header, sizeof(Header));
+		}
+	} else if(out->method == OUTPUT_DIRECT) {
+		if(pos != out->blockstart+(off_t)out->blocklen) {
+			status = flush_outfile(out);
+			out->blockstart = pos;
+		}
+		/* blocks end at multiples of OUTPUT_BLOCK in file */
+		for(done=0; done<out->slicesize && !status; done+=n) {
+			n = OUTPUT_BLOCK-(out->blockstart+out->blocklen) % OUTPUT_BLOCK;
+			if(n > out->slicesize-done)
+				n = out->slicesize-done;
+			memcpy(out->block+out->blocklen, (const char *)data+done, n);
+			out->blocklen += n;
+			if((out->blockstart+out->blocklen) % OUTPUT_BLOCK == 0)
+				status = flush_outfile(out);
+		}
+		out->header->nyear++;
+	} else if(out->positional) {
+		status = write_at(fileno(out->file), data, out->slicesize, pos);
+	} else {
+		status = (fwrite(data, out->yearsize, 1, out->file) != 1);
+		/* header counts only complete years, so an interrupted file can be resumed */
+		out->header->nyear++;
+		fflush(out->file);
+		fseek(out->file, 7, SEEK_SET);
+		fwrite(out->header, sizeof(Header), 1, out->file);
+		fseek(out->file, 0, SEEK_END);
+		fflush(out->file);
+	}
+	out->bytes += out->slicesize;
+	out->seconds += wallclock()-start;
+	return status;
+} // of 'write_outfile'
+
+/* writes header with nyear years, cuts preallocated file to its size and closes file */
+static int close_outfile(Outfile *out, int nyear) {
+	int status;
+	double start = wallclock();
+	status = flush_outfile(out);
+	if(!out->owner) {
+		/* other ranks only write their data */
+		if(out->map != NULL) {
+			if(msync(out->map, out->size, MS_SYNC))
+				status = -1;
+			munmap(out->map, out->size);
+		}
+		if(fclose(out->file))
+			status = -1;
+		free(out->block);
+		out->seconds += wallclock()-start;
+		return status;
+	}
+	out->header->nyear = nyear;
+	if(out->map != NULL) {
+		memcpy(out->map+7, out->header, sizeof(Header));
+		if(msync(out->map, out->size, MS_SYNC))
+			status = -1;
+		munmap(out->map, out->size);
+	} else {
+		fflush(out->file);
+		fseek(out->file, 7, SEEK_SET);
+		fwrite(out->header, sizeof(Header), 1, out->file);
+		fflush(out->file);
+	}
+	if(out->size > out->headersize+nyear*out->yearsize && ftruncate(fileno(out->file), out->headersize+nyear*out->yearsize))
+		status = -1;
+	if(fclose(out->file))
+		status = -1;
+	free(out->block);
+	out->seconds += wallclock()-start;
+	return status;
+} // of 'close_outfile'
+
+// ***** buffers of one year passed from reading to converting to writing *****
+#define YEAR_FREE 0
+#define YEAR_READ 1
+#define YEAR_CONVERTED 2
+
+typedef struct {
+	float *nc_data; // values read from NetCDF, see 'Readplan'
+	float *nc_data2; // values of second variable if derived variable
+	float *clm_data; // in streaming mode values read from NetCDF before conversion
+	short *clm_writedata_short;
+	float *qtab; // offset and scale of each cell or of the year with -quantize
+	float *aggr[NAGGR]; // values of aggregate outputs, NULL if not written by any variable
+	float *leapval; // value of leap day of each cell in streaming mode
+	int state;
+	int status; // status of reading from NetCDF
+	int leap_yr;
+	size_t time_len;
+	int year; // year of current NetCDF-file held in buffer
+	double read_time, gather_time; // seconds spent reading the year and gathering it in streaming mode
+} Yearbuffer;
+
+typedef struct {
+	Yearbuffer *buf; // year n of current file uses buf[n % nbuf]
+	int nbuf;
+	int firstyear, number_yr; // years of current NetCDF-file
+	int startyr; // first year of current file not yet converted
+	size_t startday; // first time step of year startyr
+	int ncid, var_id;
+	const Derivedvar *derived; // NULL if no derived variable
+	int ncid2, var_id2; // second variable of derived variable
+	float fill_value, fill_value2;
+	const Readplan *plan;
+	const size_t *nc_base, *nc_stride;
+	Gatherfunc gather; // gather for the order of the cells, see 'select_gather'
+	int chunk; // number of days read at once in streaming mode, 0 to read whole years
+	int time_align; // time extent of chunks of input, reads of streaming mode end at its multiples, 0 if not chunked
+	float *nc_chunk, *nc_chunk2; // values read in streaming mode, used by reader only
+	Outfile *out;
+	Outfile *qout; // offset and scale of each year with -quantize, NULL otherwise
+	Outfile *aggr_out[NAGGR]; // monthly and annual aggregates, NULL if not written
+	int outyear; // year of CLM file of first year of current NetCDF-file
+	const Metrics *metrics;
+	int ncells;
+	int writefloat;
+	int quantize; // values are written as short with factors in qout
+	int abort; // set if converting stops early, reader and writer stop as well
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+} Pipeline;
+
+#define MAXOUTPUTS (2+NAGGR)
+
+/* lists CLM file and further outputs of pipe, returns number of outputs */
+static int list_outputs(const Pipeline *pipe, Outfile **outs) {
+	int i, n = 0;
+	outs[n++] = pipe->out;
+	if(pipe->qout != NULL)
+		outs[n++] = pipe->qout;
+	for(i=0; i<NAGGR; i++)
+		if(pipe->aggr_out[i] != NULL)
+			outs[n++] = pipe->aggr_out[i];
+	return n;
+} // of 'list_outputs'
+
+static int flush_outputs(const Pipeline *pipe) {
+	Outfile *outs[MAXOUTPUTS];
+	int i, n = list_outputs(pipe, outs), status = 0;
+	for(i=0; i<n; i++)
+		if(flush_outfile(outs[i]))
+			status = -1;
+	return status;
+} // of 'flush_outputs'
+
+static int isleap(int year) {
+	return ((year%4 == 0) && (year%100 != 0)) || (year%400 == 0);
+}
+
+/* reads ndays days starting at firstday into nc_data (and nc_data2) and computes derived variable */
+static int read_days(const Pipeline *pipe, size_t firstday, size_t ndays, float *nc_data, float *nc_data2) {
+	int status;
+	size_t i;
+	status = read_plan(pipe->ncid, pipe->var_id, pipe->plan, firstday, ndays, nc_data);
+	if(pipe->derived == NULL || status != NC_NOERR)
+		return status;
+	status = read_plan(pipe->ncid2, pipe->var_id2, pipe->plan, firstday, ndays, nc_data2);
+	if(status != NC_NOERR)
+		return status;
+	for(i=0; i<pipe->plan->nseg; i++)
+		derive_values(pipe->derived, nc_data + pipe->plan->seg[i].offset*pipe->plan->ndays, nc_data2 + pipe->plan->seg[i].offset*pipe->plan->ndays,
+			ndays*pipe->plan->seg[i].nlat*pipe->plan->seg[i].nlon, pipe->fill_value, pipe->fill_value2);
+	return NC_NOERR;
+} // of 'read_days'
+
+/* gathers days [day, day+ndays) of the year from nc_chunk into rows of clm_data
+ * and leapval of all cells */
+static void gather_days(const Pipeline *pipe, Yearbuffer *buf, int day, int ndays) {
+	int block, nblock, first, n, clm_day;
+	for(block=0; block<pipe->ncells; block+=GATHER_CELLS) {
+		nblock = (pipe->ncells-block < GATHER_CELLS) ? pipe->ncells-block : GATHER_CELLS;
+		for(first=day; first<day+ndays; first+=n) {
+			if(buf->leap_yr && first == 59) {
+				n = 1;
+				pipe->gather(pipe->nc_chunk, pipe->nc_base, pipe->nc_stride, block, nblock, first-day, 1, buf->leapval+block, 1);
+				continue;
+			}
+			/* days up to the leap day or up to the end of the chunk */
+			n = (buf->leap_yr && first < 59 && day+ndays > 59) ? 59-first : day+ndays-first;
+			clm_day = (buf->leap_yr && first > 59) ? first-1 : first;
+			pipe->gather(pipe->nc_chunk, pipe->nc_base, pipe->nc_stride, block, nblock, first-day, n, buf->clm_data+(size_t)block*365+clm_day, 365);
+		}
+	}
+} // of 'gather_days'
+
+static void read_year(const Pipeline *pipe, Yearbuffer *buf, int year, size_t firstday) {
+	int day, ndays;
+	double start = wallclock();
+	buf->year = year;
+	buf->leap_yr = isleap(pipe->firstyear+year);
+	buf->time_len = buf->leap_yr ? 366 : 365;
+	buf->gather_time = 0;
+	if(pipe->chunk == 0) {
+		buf->status = read_days(pipe, firstday, buf->time_len, buf->nc_data, buf->nc_data2);
+		buf->read_time = wallclock()-start;
+		return;
+	}
+	/* streaming mode: read chunks of days and gather them into clm_data */
+	for(day=0; day<buf->time_len; day+=ndays) {
+		ndays = (buf->time_len-day < pipe->chunk) ? buf->time_len-day : pipe->chunk;
+		/* end reads inside the year at chunk boundaries of the time dimension */
+		if(pipe->time_align > 1 && day+ndays < buf->time_len && (firstday+day+ndays) % pipe->time_align < ndays)
+			ndays -= (firstday+day+ndays) % pipe->time_align;
+		buf->status = read_days(pipe, firstday+day, ndays, pipe->nc_chunk, pipe->nc_chunk2);
+		if(buf->status != NC_NOERR)
+			break;
+		buf->gather_time -= wallclock();
+		gather_days(pipe, buf, day, ndays);
+		buf->gather_time += wallclock();
+	}
+	buf->read_time = wallclock()-start-buf->gather_time;
+} // of 'read_year'
+
+static void write_year(const Pipeline *pipe, const Yearbuffer *buf) {
+	Yearmetrics *ym = year_metrics(pipe->metrics, pipe->outyear+buf->year);
+	Outfile *outs[MAXOUTPUTS];
+	int i, n = list_outputs(pipe, outs);
+	double seconds = 0;
+	/* time writing further outputs counts for the year as well */
+	for(i=0; i<n; i++)
+		seconds -= outs[i]->seconds;
+	/* further outputs first, so a resumed file never holds years without them */
+	if(pipe->qout != NULL && write_outfile(pipe->qout, pipe->outyear+buf->year, buf->qtab))
+		fprintf(stderr, "Error writing year %d to file of quantization factors\n", pipe->firstyear+buf->year);
+	for(i=0; i<NAGGR; i++)
+		if(pipe->aggr_out[i] != NULL && write_outfile(pipe->aggr_out[i], pipe->outyear+buf->year, buf->aggr[i]))
+			fprintf(stderr, "Error writing year %d to file of %s %s\n", pipe->firstyear+buf->year, aggr_periods[i/NSTATS], aggr_stats[i%NSTATS]);
+	if(write_outfile(pipe->out, pipe->outyear+buf->year, (pipe->writefloat && !pipe->quantize) ? (void *)buf->clm_data : (void *)buf->clm_writedata_short))
+		fprintf(stderr, "Error writing year %d to clm_file\n", pipe->firstyear+buf->year);
+	if(ym != NULL) {
+		ym->write_bytes = 0;
+		for(i=0; i<n; i++) {
+			seconds += outs[i]->seconds;
+			ym->write_bytes += outs[i]->slicesize;
+		}
+		ym->write = seconds;
+	}
+} // of 'write_year'
+
+/* wait until buffer has reached state; returns 0 if pipeline was aborted before */
+static int wait_state(Pipeline *pipe, Yearbuffer *buf, int state) {
+	int reached;
+	pthread_mutex_lock(&pipe->mutex);
+	while(buf->state != state && !pipe->abort)
+		pthread_cond_wait(&pipe->cond, &pipe->mutex);
+	reached = (buf->state == state);
+	pthread_mutex_unlock(&pipe->mutex);
+	return reached;
+}
+
+static void set_state(Pipeline *pipe, Yearbuffer *buf, int state) {
+	pthread_mutex_lock(&pipe->mutex);
+	buf->state = state;
+	pthread_cond_broadcast(&pipe->cond);
+	pthread_mutex_unlock(&pipe->mutex);
+}
+
+static void abort_pipeline(Pipeline *pipe) {
+	pthread_mutex_lock(&pipe->mutex);
+	pipe->abort = 1;
+	pthread_cond_broadcast(&pipe->cond);
+	pthread_mutex_unlock(&pipe->mutex);
+}
+
+static void *reader_thread(void *arg) {
+	Pipeline *pipe = (Pipeline *)arg;
+	Yearbuffer *buf;
+	int year;
+	size_t firstday = pipe->startday;
+	for(year=pipe->startyr; year<pipe->number_yr; year++) {
+		buf = &pipe->buf[year % pipe->nbuf];
+		if(!wait_state(pipe, buf, YEAR_FREE))
+			break;
+		read_year(pipe, buf, year, firstday);
+		set_state(pipe, buf, YEAR_READ);
+		if(buf->status != NC_NOERR)
+			break;
+		firstday += buf->time_len;
+	}
+	return NULL;
+} // of 'reader_thread'
+
+static void *writer_thread(void *arg) {
+	Pipeline *pipe = (Pipeline *)arg;
+	Yearbuffer *buf;
+	int year;
+	for(year=pipe->startyr; year<pipe->number_yr; year++) {
+		buf = &pipe->buf[year % pipe->nbuf];
+		/* years converted before an abort are still written */
+		if(!wait_state(pipe, buf, YEAR_CONVERTED))
+			break;
+		write_year(pipe, buf);
+		set_state(pipe, buf, YEAR_FREE);
+	}
+	return NULL;
+} // of 'writer_thread'
+
+// ***** settings and state of a conversion run *****
+#define SPLIT_CELLS 0 // each MPI rank converts a range of cells of all files
+#define SPLIT_YEARS 1 // each MPI rank converts whole input files
+
+static const char *split_methods[] = {"cells", "years"};
+
+typedef struct {
+	int nthreads;
+	int sparse;
+	int nbuf; // number of year buffers, >1 for pipelined processing
+	int chunk; // days read at once in streaming mode, 0 if not set
+	long max_mem; // limit of memory for data in MB in streaming mode, 0 if not set
+	char *mapcache_dir;
+	int resume; // append to existing output files
+	int nfiles; // number of input files converted concurrently by separate processes
+	int output; // OUTPUT_STDIO, OUTPUT_DIRECT or OUTPUT_MMAP
+	int timing; // print time spent in each stage
+	int max_messages; // detailed messages about values printed per output file, <0 for no limit
+	FILE *metrics; // JSON report of metrics if not NULL
+	int split; // SPLIT_CELLS or SPLIT_YEARS between MPI ranks, -1 if not set
+	int netcdf; // write NetCDF-4 copy of each CLM file
+	int nc_chunkcells, nc_chunkyears; // chunk shape of NetCDF-4 copy, 0 for all cells or years
+	int nc_deflate, nc_shuffle; // compression of NetCDF-4 copy
+	const Kernels *kernels; // conversion kernels, see nc2clm_kernels.h
+} Options; // options shared by all variables
+
+typedef struct {
+	int number_infiles;
+	char **infiles;
+	char *var;
+	int firstyear; // should be the first year of the first NetCDF-file
+	int startyear, endyear; // years written to CLM file set by -startyear and -endyear, endyear 0 if not limited
+	float offset, convert, scalar;
+	char *path_to_outfile;
+	int writefloat;
+	int quantize; // QUANTIZE_CELL or QUANTIZE_YEAR to write float values as short, QUANTIZE_NONE otherwise
+	int aggregates; // monthly and annual aggregates written, see 'aggregate_row'
+	int leapday; // LEAPDAY_DROP or LEAPDAY_REDISTRIBUTE
+	int checkfill; // report fill values and NaN
+	const Derivedvar *derived; // NULL if no derived variable
+	char *var2;
+	char **infiles2; // input files of second variable of derived variable
+	char **args; // NULL-terminated arguments of line in spec file, NULL for command line
+} Variable; // settings of one output file
+
+typedef struct {
+	char *path;
+	Header header;
+	int ncells;
+	short *data;
+	uint64_t key; // hash of grid, part of key of mapping cache
+	int *ilon, *ilat;
+	size_t *nc_base, *nc_stride;
+	int have_mapping; // ilat and ilon are valid for coordinates with prev_mapkey
+	uint64_t prev_mapkey;
+	int cell0; // number of first cell in grid file, >0 for the cells of an MPI rank
+} Grid;
+
+typedef struct {
+	double map, read, gather, convert, write; // seconds, gather and convert summed over threads
+	long long read_bytes, write_bytes;
+	long long values; // number of cells times days converted
+} Timing;
+
+typedef struct {
+	short grid_error, file_error, memory_error;
+	long int fill_error, range_error;
+	Timing timing;
+	int nyear; // years in CLM file
+	float quant_error; // largest error of values quantized with -quantize
+} Result;
+
+void usage(char* progname){
+	int i;
+	fprintf(stderr, "Use: %s number_of_infiles infilenames var firstyear path_to_gridfile offset convert scalar path_to_outfile [-float] [-quantize cell|year] [-startyear YEAR] [-endyear YEAR] [-monthly STATS] [-annual STATS] [-leapday drop|redistribute] [-nofillcheck] [-threads N] [-sparse] [-pipeline N] [-chunk DAYS] [-max-mem MB] [-mapcache DIR] [-kernel NAME] [-resume] [-files N] [-output stdio|direct|mmap] [-timing] [-max-messages N] [-metrics FILE] [-mpi cells|years] [-netcdf] [-nc-chunk CELLS YEARS] [-nc-deflate LEVEL] [-nc-noshuffle] [-derive name var2 infilenames2]\n", progname);
+	fprintf(stderr, "  or %s -spec specfile path_to_gridfile [-threads N] [-sparse] [-pipeline N] [-chunk DAYS] [-max-mem MB] [-mapcache DIR] [-kernel NAME] [-resume] [-files N] [-output stdio|direct|mmap] [-timing] [-max-messages N] [-metrics FILE] [-mpi cells|years] [-netcdf] [-nc-chunk CELLS YEARS] [-nc-deflate LEVEL] [-nc-noshuffle]\n", progname);
+	fprintf(stderr, "Provide as many infilenames as number_of_infiles.\n");
+	fprintf(stderr, "var: variable name in NetCDF files (only provided once, not for each file)\n");
+  fprintf(stderr, "firstyear: first year of generated CLM file, corresponds to first year in first input file\n");
+  fprintf(stderr, "path_to_gridfile: must be input grid with new header\n");
+	fprintf(stderr, "offset: offset added to values read from input file\n");
+  fprintf(stderr, "convert: conversion factor, multiplied with input values (after adding offset)\n");
+  fprintf(stderr, "scalar: scalar to be used in LPJmL when reading CLM2 (written to header, has no effect on values in this program)\n");
+	fprintf(stderr, "path_to_outfile: all input files are combined into one single output file (CLM2).\n");
+  fprintf(stderr, "-float: optional parameter to force generation of CLM3 with data type LPJ_FLOAT. Default is to omit this parameter and generate CLM2 with LPJ_SHORT.\n");
+  fprintf(stderr, "-quantize cell|year: optional parameter to convert values like with -float, but to store them as 16 bit integers (data type LPJ_SHORT in CLM type 3) with an offset and scale of each cell and year or of each year. The factors are written as bands 1 (offset) and 2 (scale) to a CLM file of type 3 named like path_to_outfile with .factors.clm instead of .clm, values are offset + stored value * scale; NaN and fill values are stored as %d. The largest quantization error is reported.\n", QUANTIZE_MISSING);
+  fprintf(stderr, "-startyear YEAR, -endyear YEAR: optional parameters to write only the years from YEAR (default firstyear) to YEAR (default last year of the last input file) to path_to_outfile; only the time steps of these years are read and the CLM header starts with startyear. Files of consecutive year ranges can be joined with clmmerge.\n");
+  fprintf(stderr, "-monthly STATS, -annual STATS: optional parameters to write monthly (12 bands) or annual (1 band) aggregates of the converted values of each cell, STATS is a comma separated list of sum, mean, min and max. Each is written as CLM type 3 with data type LPJ_FLOAT and the scalar of path_to_outfile to a file named like path_to_outfile with e.g. .monthly_mean.clm instead of .clm. Months have no leap days, the leap day is dropped or distributed over february like for path_to_outfile; values are aggregated before rounding, fill values and NaN are skipped.\n");
+  fprintf(stderr, "-leapday drop|redistribute: optional parameter to drop the value of 29 February in leap years or to distribute it over all days of February. Default is redistribute for pr, prsn and prec and drop for all other variables.\n");
+  fprintf(stderr, "-nofillcheck: optional parameter to convert fill values and NaN without counting and reporting them.\n");
+  fprintf(stderr, "-threads N: optional parameter to split the conversion of grid cells across N threads. Default is 1.\n");
+  fprintf(stderr, "-sparse: optional parameter to read only latitude rows and longitude runs of NetCDF files that contain cells of the grid file instead of global fields.\n");
+  fprintf(stderr, "-pipeline N: optional parameter to read the next year and write the previous year while converting the current year, with at most N (>=2) years held in memory. Default is to process years one after the other.\n");
+  fprintf(stderr, "-chunk DAYS: optional parameter to stream NetCDF data in chunks of DAYS days into the year buffers instead of reading whole years.\n");
+  fprintf(stderr, "-max-mem MB: optional parameter to stream NetCDF data in chunks as large as possible without exceeding MB megabytes for data buffers and the chunk cache of chunked input, which gets at most half of the memory left after the year buffers.\n");
+  fprintf(stderr, "-mapcache DIR: optional parameter to store the mapping of grid cells to NetCDF coordinates in directory DIR and reuse it in later runs with the same grid file and coordinates.\n");
+  fprintf(stderr, "-resume: optional parameter to continue an interrupted conversion: if path_to_outfile exists and its header matches, years already converted are skipped and the remaining years are appended. The header is updated after each year.\n");
+  fprintf(stderr, "-files N: optional parameter to convert up to N input files at the same time in separate processes, each writing its years directly to their position in path_to_outfile. Output is identical to converting the files one after the other.\n");
+  fprintf(stderr, "-output stdio|direct|mmap: optional parameter to choose how path_to_outfile is written: stdio appends years with buffered writes, direct preallocates the file and writes blocks of %d MB aligned in the file, mmap preallocates the file and copies years into a memory mapping of it. Default is stdio. The write throughput is reported.\n", OUTPUT_BLOCK/(1024*1024));
+  fprintf(stderr, "-timing: optional parameter to print the time spent mapping the grid, reading, gathering, converting and writing values for each output file. Times of gathering and converting are summed over threads.\n");
+  fprintf(stderr, "-max-messages N: optional parameter to print at most N messages about single fill values, NaN and values out of range per output file, -1 for no limit. Default is 1000. All values are still counted for each year and each cell.\n");
+  fprintf(stderr, "-metrics FILE: optional parameter to write a JSON report with the time spent in each stage, bytes read and written and counts of fill values, NaN and values out of range for each output file, each year and the cells with most of them.\n");
+  fprintf(stderr, "-mpi cells|years: optional parameter if compiled with -DUSE_MPI and started with mpirun to split the grid cells or the input files between MPI ranks, each writing its part of path_to_outfile. Output is identical to a single process. -files is ignored with -mpi.\n");
+  fprintf(stderr, "-netcdf: optional parameter to write the converted values also into a NetCDF-4 file named like path_to_outfile with .nc instead of .clm, with variable (cell, time), coordinates lon and lat of each cell and the CLM header as attributes.\n");
+  fprintf(stderr, "-nc-chunk CELLS YEARS: optional parameter to set the chunks of the NetCDF-4 file to CELLS cells and YEARS years, 0 for all cells or all years. Default is 1024 cells and all years, so reading a few cells reads few chunks; 0 1 reads one year of all cells at once.\n");
+  fprintf(stderr, "-nc-deflate LEVEL: optional parameter to set the deflate level (0-9) of the NetCDF-4 file, 0 for no compression. Default is 4.\n");
+  fprintf(stderr, "-nc-noshuffle: optional parameter to compress the NetCDF-4 file without shuffle filter.\n");
+  fprintf(stderr, "-kernel NAME: optional parameter to select the conversion kernels instead of the fastest supported by the CPU, results are identical. Kernels:");
+  for(i=0; i<sizeof(kernels)/sizeof(kernels[0]); i++)
+    fprintf(stderr, " %s", kernels[i].name);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "-derive name var2 infilenames2: optional parameter to convert a variable derived from var and variable var2 read from a second set of number_of_infiles files covering the same years. Derived variables:\n");
+  for(i=0; i<sizeof(derivedvars)/sizeof(derivedvars[0]); i++)
+    fprintf(stderr, "    %s: %s\n", derivedvars[i].name, derivedvars[i].description);
+  fprintf(stderr, "-spec specfile: convert several variables in one run sharing grid and threads. Each line of specfile holds the arguments of one variable without path_to_gridfile:\n");
+  fprintf(stderr, "    number_of_infiles infilenames var firstyear offset convert scalar path_to_outfile [-float] [-quantize cell|year] [-startyear YEAR] [-endyear YEAR] [-monthly STATS] [-annual STATS] [-leapday drop|redistribute] [-nofillcheck] [-derive name var2 infilenames2]\n");
+  fprintf(stderr, "  Empty lines and lines starting with # are ignored.\n\n");
+  fprintf(stderr, "Note: data conversion: CLM data = (NetCDF data + offset) * convert\n");
+	exit(-1);
+}
+
+/* parses option at argv[*arg] shared by all variables, returns 0 if option is unknown */
+static int parse_option(int argc, char **argv, int *arg, Options *opt, char *progname) {
+	if(strcmp(argv[*arg], "-threads") == 0) {
+		if(*arg+1 == argc)
+			usage(progname);
+		opt->nthreads = atoi(argv[++*arg]);
+		if(opt->nthreads < 1) {
+			fprintf(stderr, "Invalid number of threads %s\n", argv[*arg]);
+			exit(-1);
+		}
+	} else if(strcmp(argv[*arg], "-sparse") == 0) {
+		opt->sparse=1;
+	} else if(strcmp(argv[*arg], "-kernel") == 0) {
+		if(*arg+1 == argc)
+			usage(progname);
+		opt->kernels = select_kernels(argv[++*arg]);
+		if(opt->kernels == NULL) {
+			fprintf(stderr, "Conversion kernels %s not available\n", argv[*arg]);
+			exit(-1);
+		}
+	} else if(strcmp(argv[*arg], "-resume") == 0) {
+		opt->resume=1;
+	} else if(strcmp(argv[*arg], "-timing") == 0) {
+		opt->timing=1;
+	} else if(strcmp(argv[*arg], "-max-messages") == 0) {
+		if(*arg+1 == argc)
+			usage(progname);
+		opt->max_messages = atoi(argv[++*arg]);
+	} else if(strcmp(argv[*arg], "-metrics") == 0) {
+		if(*arg+1 == argc)
+			usage(progname);
+		++*arg;
+		/* report is written by rank 0 only, other ranks write into a temporary file */
+		opt->metrics = (mpi_rank == 0) ? fopen(argv[*arg], "w") : tmpfile();
+		if(opt->metrics == NULL) {
+			fprintf(stderr, "Error creating metrics file %s\n", argv[*arg]);
+			exit(-1);
+		}
+	} else if(strcmp(argv[*arg], "-output") == 0) {
+		if(*arg+1 == argc)
+			usage(progname);
+		for(opt->output=0; opt->output<sizeof(output_methods)/sizeof(output_methods[0]); opt->output++)
+			if(strcmp(argv[*arg+1], output_methods[opt->output]) == 0)
+				break;
+		if(opt->output == sizeof(output_methods)/sizeof(output_methods[0])) {
+			fprintf(stderr, "Invalid output method %s\n", argv[*arg+1]);
+			exit(-1);
+		}
+		++*arg;
+	} else if(strcmp(argv[*arg], "-netcdf") == 0) {
+		opt->netcdf=1;
+	} else if(strcmp(argv[*arg], "-nc-noshuffle") == 0) {
+		opt->nc_shuffle=0;
+	} else if(strcmp(argv[*arg], "-nc-chunk") == 0) {
+		if(*arg+2 >= argc)
+			usage(progname);
+		opt->nc_chunkcells = atoi(argv[++*arg]);
+		opt->nc_chunkyears = atoi(argv[++*arg]);
+		if(opt->nc_chunkcells < 0 || opt->nc_chunkyears < 0) {
+			fprintf(stderr, "Invalid chunk of NetCDF-4 file %s %s\n", argv[*arg-1], argv[*arg]);
+			exit(-1);
+		}
+	} else if(strcmp(argv[*arg], "-nc-deflate") == 0) {
+		if(*arg+1 == argc)
+			usage(progname);
+		opt->nc_deflate = atoi(argv[++*arg]);
+		if(opt->nc_deflate < 0 || opt->nc_deflate > 9) {
+			fprintf(stderr, "Invalid deflate level %s\n", argv[*arg]);
+			exit(-1);
+		}
+	} else if(strcmp(argv[*arg], "-mpi") == 0) {
+		if(*arg+1 == argc)
+			usage(progname);
+#ifndef USE_MPI
+		fprintf(stderr, "-mpi needs %s compiled with -DUSE_MPI\n", progname);
+		exit(-1);
+#endif
+		for(opt->split=0; opt->split<sizeof(split_methods)/sizeof(split_methods[0]); opt->split++)
+			if(strcmp(argv[*arg+1], split_methods[opt->split]) == 0)
+				break;
+		if(opt->split == sizeof(split_methods)/sizeof(split_methods[0])) {
+			fprintf(stderr, "Invalid split between MPI ranks %s\n", argv[*arg+1]);
+			exit(-1);
+		}
+		++*arg;
+	} else if(strcmp(argv[*arg], "-files") == 0) {
+		if(*arg+1 == argc)
+			usage(progname);
+		opt->nfiles = atoi(argv[++*arg]);
+		if(opt->nfiles < 1) {
+			fprintf(stderr, "Invalid number of files %s\n", argv[*arg]);
+			exit(-1);
+		}
+	} else if(strcmp(argv[*arg], "-chunk") == 0) {
+		if(*arg+1 == argc)
+			usage(progname);
+		opt->chunk = atoi(argv[++*arg]);
+		if(opt->chunk < 1) {
+			fprintf(stderr, "Invalid number of days %s\n", argv[*arg]);
+			exit(-1);
+		}
+	} else if(strcmp(argv[*arg], "-max-mem") == 0) {
+		if(*arg+1 == argc)
+			usage(progname);
+		opt->max_mem = atol(argv[++*arg]);
+		if(opt->max_mem < 1) {
+			fprintf(stderr, "Invalid memory limit %s\n", argv[*arg]);
+			exit(-1);
+		}
+	} else if(strcmp(argv[*arg], "-mapcache") == 0) {
+		if(*arg+1 == argc)
+			usage(progname);
+		opt->mapcache_dir = argv[++*arg];
+	} else if(strcmp(argv[*arg], "-pipeline") == 0) {
+		if(*arg+1 == argc)
+			usage(progname);
+		opt->nbuf = atoi(argv[++*arg]);
+		if(opt->nbuf < 2) {
+			fprintf(stderr, "Invalid number of year buffers %s, must be at least 2\n", argv[*arg]);
+			exit(-1);
+		}
+	} else
+		return 0;
+	return 1;
+} // of 'parse_option'
+
+/* adds the statistics in comma separated list (e.g. "sum,mean") of period to
+ * aggregates, returns 0 on success */
+static int parse_aggregates(const char *list, int period, int *aggregates) {
+	int stat;
+	size_t len;
+	while(*list != '\0') {
+		len = strcspn(list, ",");
+		for(stat=0; stat<NSTATS; stat++)
+			if(strlen(aggr_stats[stat]) == len && strncmp(list, aggr_stats[stat], len) == 0)
+				break;
+		if(stat == NSTATS) {
+			fprintf(stderr, "Unknown statistic %.*s of %s aggregates\n", (int)len, list, aggr_periods[period]);
+			return -1;
+		}
+		*aggregates |= 1 << (period*NSTATS+stat);
+		list += len;
+		if(*list == ',')
+			list++;
+	}
+	return 0;
+} // of 'parse_aggregates'
+
+/* parses arguments of one variable starting with number_of_infiles at argv[0].
+ * path_to_gridfile is expected after firstyear if path_to_gridfile is not NULL,
+ * options shared by all variables are only accepted if opt is not NULL.
+ * Returns 0 on success */
+static int parse_variable(int argc, char **argv, Variable *v, char **path_to_gridfile, Options *opt, char *progname) {
+	int arg, ngrid = (path_to_gridfile != NULL);
+	if(argc < 1)
+		return -1;
+	v->number_infiles = atoi(argv[0]);
+	if(v->number_infiles < 1 || argc < v->number_infiles+7+ngrid)
+		return -1;
+	v->infiles = argv+1;
+	v->var = argv[v->number_infiles+1];
+	v->firstyear = atoi(argv[v->number_infiles+2]);
+	if(ngrid)
+		*path_to_gridfile = argv[v->number_infiles+3];
+	v->offset = (float)atof(argv[v->number_infiles+3+ngrid]);	
+	v->convert = (float)atof(argv[v->number_infiles+4+ngrid]);	
+	v->scalar = (float)atof(argv[v->number_infiles+5+ngrid]);	
+	v->path_to_outfile = argv[v->number_infiles+6+ngrid];
+	v->writefloat = 0;
+	v->quantize = QUANTIZE_NONE;
+	v->startyear = v->firstyear;
+	v->endyear = 0;
+	v->aggregates = 0;
+	/* precipitation keeps the leap day by default */
+	if(strcmp(v->var,"pr") == 0 || strcmp(v->var,"prsn") == 0 || strcmp(v->var, "prec") == 0)
+		v->leapday = LEAPDAY_REDISTRIBUTE;
+	else
+		v->leapday = LEAPDAY_DROP;
+	v->checkfill = 1;
+	v->derived = NULL;
+	v->var2 = NULL;
+	v->infiles2 = NULL;
+	v->args = NULL;
+  for(arg=v->number_infiles+7+ngrid; arg<argc; arg++) {
+    if(strcmp(argv[arg], "-float") == 0) {
+      v->writefloat=1;
+    } else if(strcmp(argv[arg], "-quantize") == 0) {
+      if(arg+1 == argc)
+        return -1;
+      arg++;
+      if(strcmp(argv[arg], quantize_methods[QUANTIZE_CELL]) == 0)
+        v->quantize = QUANTIZE_CELL;
+      else if(strcmp(argv[arg], quantize_methods[QUANTIZE_YEAR]) == 0)
+        v->quantize = QUANTIZE_YEAR;
+      else {
+        fprintf(stderr, "Unknown quantization %s\n", argv[arg]);
+        return -1;
+      }
+      /* values are converted like with -float */
+      v->writefloat=1;
+    } else if(strcmp(argv[arg], "-leapday") == 0) {
+      if(arg+1 == argc)
+        return -1;
+      arg++;
+      if(strcmp(argv[arg], "drop") == 0)
+        v->leapday = LEAPDAY_DROP;
+      else if(strcmp(argv[arg], "redistribute") == 0)
+        v->leapday = LEAPDAY_REDISTRIBUTE;
+      else {
+        fprintf(stderr, "Unknown leap day policy %s\n", argv[arg]);
+        return -1;
+      }
+    } else if(strcmp(argv[arg], "-monthly") == 0 || strcmp(argv[arg], "-annual") == 0) {
+      if(arg+1 == argc)
+        return -1;
+      if(parse_aggregates(argv[arg+1], (strcmp(argv[arg], "-monthly") == 0) ? AGGR_MONTHLY : AGGR_ANNUAL, &v->aggregates))
+        return -1;
+      arg++;
+    } else if(strcmp(argv[arg], "-startyear") == 0) {
+      if(arg+1 == argc)
+        return -1;
+      v->startyear = atoi(argv[++arg]);
+    } else if(strcmp(argv[arg], "-endyear") == 0) {
+      if(arg+1 == argc)
+        return -1;
+      v->endyear = atoi(argv[++arg]);
+    } else if(strcmp(argv[arg], "-nofillcheck") == 0) {
+      v->checkfill=0;
+    } else if(strcmp(argv[arg], "-derive") == 0) {
+      if(arg+2+v->number_infiles >= argc)
+        return -1;
+      v->derived = find_derivedvar(argv[arg+1]);
+      if(v->derived == NULL) {
+        fprintf(stderr, "Unknown derived variable %s\n", argv[arg+1]);
+        return -1;
+      }
+      v->var2 = argv[arg+2];
+      v->infiles2 = argv+arg+3;
+      arg += 2+v->number_infiles;
+    } else if(opt != NULL && parse_option(argc, argv, &arg, opt, progname)) {
+      continue;
+    } else {
+      fprintf(stdout, "\t\tUnknown argument %s\n", argv[arg]);
+    }
+  }
+	if(v->startyear < v->firstyear) {
+		fprintf(stderr, "-startyear %d is before firstyear %d\n", v->startyear, v->firstyear);
+		return -1;
+	}
+	if(v->endyear != 0 && v->endyear < v->startyear) {
+		fprintf(stderr, "-endyear %d is before first year %d\n", v->endyear, v->startyear);
+		return -1;
+	}
+	return 0;
+} // of 'parse_variable'
+
+/* frees NULL-terminated arguments */
+static void free_args(char **args) {
+	char **arg;
+	if(args == NULL)
+		return;
+	for(arg=args; *arg!=NULL; arg++)
+		free(*arg);
+	free(args);
+} // of 'free_args'
+
+/* frees nvar variables and the arguments read for them from a spec file */
+static void free_variables(Variable *vars, int nvar) {
+	int i;
+	for(i=0; i<nvar; i++)
+		free_args(vars[i].args);
+	free(vars);
+} // of 'free_variables'
+
+/* reads variables from spec file, one variable per line; returns number of variables or -1 on error */
+static int read_spec(const char *filename, Variable **vars, char *progname) {
+	FILE *file;
+	char line[65536], *token, **args, **newargs;
+	int nvar, nargs, maxargs, lineno;
+	Variable *v;
+	file = fopen(filename, "r");
+	if(file == NULL) {
+		fprintf(stderr, "Error opening spec file %s\n", filename);
+		return -1;
+	}
+	*vars = NULL;
+	args = NULL;
+	nvar = lineno = 0;
+	while(fgets(line, sizeof(line), file) != NULL) {
+		lineno++;
+		if(strlen(line) == sizeof(line)-1 && line[sizeof(line)-2] != '\n') {
+			fprintf(stderr, "Line %d in spec file %s too long\n", lineno, filename);
+			goto error;
+		}
+		/* split line into arguments, which are kept for the whole run */
+		maxargs = 16;
+		args = (char **)calloc(maxargs, sizeof(char *));
+		if(args == NULL)
+			goto error;
+		nargs = 0;
+		for(token=strtok(line, " \t\r\n"); token!=NULL; token=strtok(NULL, " \t\r\n")) {
+			if(nargs == 0 && token[0] == '#')
+				break;
+			if(nargs+1 == maxargs) {
+				/* keep room for terminating NULL */
+				newargs = (char **)realloc(args, sizeof(char *)*maxargs*2);
+				if(newargs == NULL)
+					goto error;
+				args = newargs;
+				memset(args+maxargs, 0, sizeof(char *)*maxargs);
+				maxargs *= 2;
+			}
+			args[nargs] = strdup(token);
+			if(args[nargs] == NULL)
+				goto error;
+			nargs++;
+		}
+		if(nargs == 0) {
+			free(args);
+			args = NULL;
+			continue;
+		}
+		v = (Variable *)realloc(*vars, sizeof(Variable)*(nvar+1));
+		if(v == NULL)
+			goto error;
+		*vars = v;
+		if(parse_variable(nargs, args, &v[nvar], NULL, NULL, progname)) {
+			fprintf(stderr, "Invalid arguments in line %d of spec file %s\n", lineno, filename);
+			goto error;
+		}
+		v[nvar].args = args;
+		args = NULL;
+		nvar++;
+	}
+	fclose(file);
+	return nvar;
+error:
+	free_args(args);
+	free_variables(*vars, nvar);
+	*vars = NULL;
+	fclose(file);
+	return -1;
+} // of 'read_spec'
+
+/* reads LPJmL grid-file, exits on error */
+static void read_grid(char *path, Grid *grid) {
+	FILE *grid_file;
+	char grid_headername[7]; // LPJGRID 
+	int cell, swap_grid = 0;
+	
+	grid->path = path;
+	// open grid-file:
+	grid_file = fopen(path, "rb");
+	if(grid_file == NULL) {
+		fprintf(stderr, "\t\terror: could not open grid_file %s\n", path);
+		exit(-1);
+	}
+	
+	// read header of grid_file:  
+	fread(grid_headername, 7, 1, grid_file);
+	fread(&grid->header, sizeof(Header), 1, grid_file);
+	
+	if(grid->header.version != 1 && grid->header.version != 2) {
+		if(swapint(grid->header.version) != 1 && swapint(grid->header.version) != 2) {
+			fprintf(stderr, "\t\tinfo: error - cannot determine endian of grid_file\n");
+			fclose(grid_file);
+			exit(-1);
+		}
+		else{
+			swap_grid = 1;
+			grid->header.version = swapint(grid->header.version);
+			grid->header.order = swapint(grid->header.order);
+			grid->header.firstyear = swapint(grid->header.firstyear);
+			grid->header.nyear = swapint(grid->header.nyear);
+			grid->header.firstcell = swapint(grid->header.firstcell);
+			grid->header.ncell = swapint(grid->header.ncell);
+			grid->header.nband = swapint(grid->header.nband);
+			grid->header.cellsize = swapfloat(grid->header.cellsize);
+			grid->header.scalar = swapfloat(grid->header.scalar);
+		}
+	}
+	grid->ncells = grid->header.ncell;
+	
+	// read grid-data:
+	grid->data = malloc(sizeof(short)*grid->ncells*2);
+	if(grid->data == NULL) {
+		fprintf(stderr, "Error allocating memory for grid_data\n");
+		fclose(grid_file);
+		exit(-1);
+	}
+	fread(grid->data, sizeof(short), grid->ncells*2, grid_file);
+	fclose(grid_file);
+	if(swap_grid == 1)
+		for(cell = 0; cell < grid->ncells*2; cell++)
+			grid->data[cell] = swapshort(grid->data[cell]);
+	grid->key = hash_bytes(0xcbf29ce484222325ULL, &grid->header.scalar, sizeof(float));
+	grid->key = hash_bytes(grid->key, &grid->ncells, sizeof(int));
+	grid->key = hash_bytes(grid->key, grid->data, sizeof(short)*grid->ncells*2);
+		
+	grid->ilon = (int*) malloc(sizeof(int)*grid->ncells);
+	grid->ilat = (int*) malloc(sizeof(int)*grid->ncells);
+	if(grid->ilat == NULL) {
+		fprintf(stderr, "Error allocating memory for ilat\n");
+		exit(-1);
+	}
+	if(grid->ilon == NULL) {
+		fprintf(stderr, "Error allocating memory for ilon\n");
+		exit(-1);
+	}
+	grid->nc_base = (size_t*) malloc(sizeof(size_t)*grid->ncells);
+	grid->nc_stride = (size_t*) malloc(sizeof(size_t)*grid->ncells);
+	if(grid->nc_base == NULL || grid->nc_stride == NULL) {
+		fprintf(stderr, "Error allocating memory for nc_base\n");
+		exit(-1);
+	}
+	grid->have_mapping = 0;
+	grid->prev_mapkey = 0;
+	grid->cell0 = 0;
+} // of 'read_grid'
+
+static void free_grid(Grid *grid) {
+	free(grid->data);
+	free(grid->ilon);
+	free(grid->ilat);
+	free(grid->nc_base);
+	free(grid->nc_stride);
+} // of 'free_grid'
+
+#ifdef USE_MPI
+/* copies ncells cells of grid starting with cell0 to part, returns 0 on success */
+static int part_grid(Grid *part, const Grid *grid, int cell0, int ncells) {
+	*part = *grid;
+	part->ncells = ncells;
+	part->cell0 = cell0;
+	part->data = (short *)malloc(sizeof(short)*2*(ncells > 0 ? ncells : 1));
+	part->ilon = (int *)malloc(sizeof(int)*(ncells > 0 ? ncells : 1));
+	part->ilat = (int *)malloc(sizeof(int)*(ncells > 0 ? ncells : 1));
+	part->nc_base = (size_t *)malloc(sizeof(size_t)*(ncells > 0 ? ncells : 1));
+	part->nc_stride = (size_t *)malloc(sizeof(size_t)*(ncells > 0 ? ncells : 1));
+	if(part->data == NULL || part->ilon == NULL || part->ilat == NULL || part->nc_base == NULL || part->nc_stride == NULL) {
+		free_grid(part);
+		return -1;
+	}
+	memcpy(part->data, grid->data+2*cell0, sizeof(short)*2*ncells);
+	/* mapping cache holds cells of part only */
+	part->key = hash_bytes(grid->key, &cell0, sizeof(int));
+	part->key = hash_bytes(part->key, &ncells, sizeof(int));
+	part->have_mapping = 0;
+	part->prev_mapkey = 0;
+	return 0;
+} // of 'part_grid'
+#endif
+
+/* writes ilat and ilon of grid for coordinates of NetCDF file */
+static void map_grid(Grid *grid, const Ncfile *nc, const Options *opt, Result *res) {
+	Coordindex latindex, lonindex;
+	uint64_t mapkey;
+	int cell;
+	mapkey = hash_bytes(grid->key, &nc->latlen, sizeof(size_t));
+	mapkey = hash_bytes(mapkey, &nc->lonlen, sizeof(size_t));
+	mapkey = hash_bytes(mapkey, nc->nclat, sizeof(double)*nc->latlen);
+	mapkey = hash_bytes(mapkey, nc->nclon, sizeof(double)*nc->lonlen);
+	if(grid->have_mapping && mapkey == grid->prev_mapkey) {
+		fprintf(stdout, "\t\tusing grid mapping of previous file\n");
+		return;
+	}
+	if(opt->mapcache_dir != NULL && !read_mapcache(opt->mapcache_dir, mapkey, grid->ncells, nc->latlen, nc->lonlen, grid->ilat, grid->ilon)) {
+		fprintf(stdout, "\t\tusing grid mapping from cache in %s\n", opt->mapcache_dir);
+	} else {
+		if(build_coordindex(&lonindex, nc->nclon, nc->lonlen) || build_coordindex(&latindex, nc->nclat, nc->latlen)) {
+			fprintf(stderr, "Error allocating memory for coordinate index\n");
+			res->memory_error=-1;
+			grid->have_mapping = 0;
+			return;
+		}
+		for(cell=0; cell<grid->ncells; cell++){
+			grid->ilon[cell] = find_coord(&lonindex, grid->data[cell*2]*grid->header.scalar);
+			grid->ilat[cell] = find_coord(&latindex, grid->data[cell*2+1]*grid->header.scalar);
+			if(is_equal(grid->ilat[cell], -999) || is_equal(grid->ilon[cell], -999)) {
+				fprintf(stderr, "Error finding cell %d (%.2f E %.2f N) in NetCDF. Aborting.\n", cell, grid->data[cell*2]*grid->header.scalar, grid->data[cell*2+1]*grid->header.scalar);
+				res->grid_error = -1;
+			}
+		}
+		free(lonindex.order);
+		free(latindex.order);
+		if(!res->grid_error && opt->mapcache_dir != NULL)
+			write_mapcache(opt->mapcache_dir, mapkey, grid->ncells, nc->latlen, nc->lonlen, grid->ilat, grid->ilon);
+	}
+	grid->have_mapping = !res->grid_error;
+	grid->prev_mapkey = mapkey;
+} // of 'map_grid'
+
+static int make_plan(Readplan *plan, int sparse, const Ncfile *nc, Grid *grid, size_t ndays) {
+	if(sparse)
+		return plan_sparse(plan, nc->latlen, nc->lonlen, grid->ilat, grid->ilon, grid->ncells, ndays, grid->nc_base, grid->nc_stride);
+	return plan_full(plan, nc->latlen, nc->lonlen, grid->ilat, grid->ilon, grid->ncells, ndays, grid->nc_base, grid->nc_stride);
+} // of 'make_plan'
+
+/* number of days read at once in streaming mode: -chunk, limited by memory
+ * left by -max-mem after year buffers, per-cell arrays and the chunk caches
+ * of the input variables; cache is reduced to at most half of the memory left
+ * after year buffers and per-cell arrays. Returns <1 if too small */
+static int stream_chunk(const Options *opt, int ncells, int nbuf, size_t daysize, int nvar, long long *cache) {
+	long long fixed, perday, chunk, left;
+	chunk = (opt->chunk > 0) ? opt->chunk : 366;
+	if(opt->max_mem > 0) {
+		fixed = (long long)nbuf*ncells*(365*(sizeof(float)+sizeof(short))+sizeof(float)) +
+			(long long)ncells*(2*sizeof(int)+2*sizeof(size_t)+2*sizeof(short));
+		left = opt->max_mem*1024*1024 - fixed;
+		if(*cache > left/2)
+			*cache = (left > 0) ? left/2 : 0;
+		perday = (long long)daysize*sizeof(float)*nvar;
+		if(left - *cache < perday*chunk)
+			chunk = (left - *cache)/perday;
+	}
+	return (chunk > 366) ? 366 : (int)chunk;
+} // of 'stream_chunk'
+
+#ifndef NC_CACHE_MAX
+#define NC_CACHE_MAX (1024L*1024*1024) // upper limit of chunk cache of each input variable
+#endif
+
+/* size of chunk cache holding all chunks with values of plan for two time
+ * blocks of the chunks, at most NC_CACHE_MAX; 0 if stored contiguous */
+static size_t chunk_cache_size(const Ncfile *nc, const Readplan *plan) {
+	size_t size;
+	if(nc->chunk[0] == 0)
+		return 0;
+	size = 2*sizeof(float)*nc->chunk[0]*nc->chunk[1]*nc->chunk[2]*plan_chunks(plan, nc->latlen, nc->lonlen, nc->chunk[1], nc->chunk[2]);
+	return (size > NC_CACHE_MAX) ? NC_CACHE_MAX : size;
+} // of 'chunk_cache_size'
+
+/* sets the chunk cache of the variable of nc to hold all chunks with values
+ * of plan for two time blocks of the chunks, so a chunk is decompressed only
+ * once although reads of years or streamed days end inside it, but to at
+ * most limit bytes; prints the chunking and returns the size of the cache,
+ * 0 if stored contiguous */
+static size_t tune_chunk_cache(const Ncfile *nc, const Readplan *plan, size_t limit) {
+	size_t nchunks, chunksize, size, nslots, i;
+	if(nc->chunk[0] == 0) {
+		fprintf(stdout, "\t\tinput stored contiguous, %s\n", nc->deflate ? "compressed" : "not compressed");
+		return 0;
+	}
+	nchunks = plan_chunks(plan, nc->latlen, nc->lonlen, nc->chunk[1], nc->chunk[2]);
+	chunksize = sizeof(float)*nc->chunk[0]*nc->chunk[1]*nc->chunk[2];
+	size = 2*nchunks*chunksize;
+	if(limit > NC_CACHE_MAX)
+		limit = NC_CACHE_MAX;
+	if(size > limit) {
+		fprintf(stdout, "\t\tWarning: chunk cache limited to %.1f MB instead of %.1f MB, chunks may be decompressed more than once\n", limit/(1024.0*1024.0), size/(1024.0*1024.0));
+		size = limit;
+	}
+	/* hash table of HDF5 works best with a prime number of slots well above the number of chunks */
+	for(nslots=20*nchunks+1; ; nslots+=2) {
+		for(i=3; i*i<=nslots && nslots%i; i+=2)
+			;
+		if(i*i > nslots)
+			break;
+	}
+	if(nc_set_var_chunk_cache(nc->ncid, nc->var_id, size, nslots, 0.75) != NC_NOERR)
+		fprintf(stdout, "\t\tWarning: could not set chunk cache\n");
+	if(nc->deflate)
+		fprintf(stdout, "\t\tinput chunks %lu x %lu x %lu (time x lat x lon), deflate level %d%s\n", (unsigned long)nc->chunk[0],
+			(unsigned long)nc->chunk[1], (unsigned long)nc->chunk[2], nc->deflate, nc->shuffle ? " with shuffle" : "");
+	else
+		fprintf(stdout, "\t\tinput chunks %lu x %lu x %lu (time x lat x lon), not compressed\n", (unsigned long)nc->chunk[0],
+			(unsigned long)nc->chunk[1], (unsigned long)nc->chunk[2]);
+	fprintf(stdout, "\t\t%lu chunks per time block read, chunk cache %.1f MB\n", (unsigned long)nchunks, size/(1024.0*1024.0));
+	return size;
+} // of 'tune_chunk_cache'
+
+/* name of further output file: path_to_outfile with suffix instead of .clm */
+static char *output_path(const char *path, const char *suffix) {
+	char *newpath;
+	size_t len = strlen(path);
+	newpath = (char *)malloc(len+strlen(suffix)+1);
+	if(newpath == NULL)
+		return NULL;
+	strcpy(newpath, path);
+	if(len > 4 && strcmp(path+len-4, ".clm") == 0)
+		newpath[len-4] = '\0';
+	strcat(newpath, suffix);
+	return newpath;
+} // of 'output_path'
+
+/* checks that existing CLM file matches header and datatype and truncates an
+ * incomplete last year and years after maxyears (if not negative); returns
+ * number of complete years kept or -1 if it does not match */
+static int check_resume(FILE *file, const Header *header, int datatype, int maxyears, const char *path) {
+	char headername[7];
+	Header old;
+	float cellsize;
+	int old_datatype, nyear;
+	long long headersize, yearsize, size;
+	headersize = 7+sizeof(Header);
+	if(fread(headername, 7, 1, file) != 1 || fread(&old, sizeof(Header), 1, file) != 1 || strncmp(headername, "LPJCLIM", 7)) {
+		fprintf(stderr, "Error: %s is not a CLM file, cannot resume\n", path);
+		return -1;
+	}
+	if(old.version != header->version || old.order != header->order || old.firstyear != header->firstyear ||
+	   old.firstcell != header->firstcell || old.ncell != header->ncell || old.nband != header->nband ||
+	   old.cellsize != header->cellsize || old.scalar != header->scalar || old.nyear < 0) {
+		fprintf(stderr, "Error: header of %s does not match settings, cannot resume\n", path);
+		return -1;
+	}
+	if(header->version == 3) {
+		headersize += sizeof(float)+sizeof(int);
+		if(fread(&cellsize, sizeof(float), 1, file) != 1 || fread(&old_datatype, sizeof(int), 1, file) != 1 ||
+		   cellsize != header->cellsize || old_datatype != datatype) {
+			fprintf(stderr, "Error: data type of %s does not match settings, cannot resume\n", path);
+			return -1;
+		}
+	}
+	yearsize = (long long)header->ncell*header->nband*((datatype == LPJ_FLOAT) ? sizeof(float) : sizeof(short));
+	fseeko(file, 0, SEEK_END);
+	size = ftello(file);
+	nyear = (maxyears >= 0 && old.nyear > maxyears) ? maxyears : old.nyear;
+	if(size < headersize+nyear*yearsize) {
+		/* header is rewritten after the data of each year, so this should not happen */
+		nyear = (int)((size-headersize)/yearsize);
+		fprintf(stdout, "\t\tWarning: %s holds only %d of %d years\n", path, nyear, old.nyear);
+	}
+	if(size > headersize+nyear*yearsize) {
+		fprintf(stdout, "\t\tdiscard %lld bytes after year %d\n", size-headersize-nyear*yearsize, nyear);
+		fflush(file);
+		if(ftruncate(fileno(file), headersize+nyear*yearsize)) {
+			fprintf(stderr, "Error truncating %s, cannot resume\n", path);
+			return -1;
+		}
+	}
+	return nyear;
+} // of 'check_resume'
+
+/* resumes existing CLM file (keeping at most maxyears if not negative) or
+ * writes header to new one, only rank 0 writes the header and other ranks
+ * open the file afterwards; returns NULL on error of any rank */
+static FILE *open_clm_file(const char *path, Header *header, int datatype, int resume, int maxyears, int *done_years) {
+	FILE *clm_file;
+	*done_years = 0;
+	clm_file = (resume && mpi_rank == 0) ? fopen(path, "r+b") : NULL;
+	if(clm_file != NULL) {
+		*done_years = check_resume(clm_file, header, datatype, maxyears, path);
+		if(*done_years < 0) {
+			fclose(clm_file);
+			clm_file = NULL;
+		} else {
+			fprintf(stdout, "\t\t* resume %s after %d years\n", path, *done_years);
+			header->nyear = *done_years;
+			fseek(clm_file, 7 ,SEEK_SET);
+			fwrite(header, sizeof(Header),1,clm_file);
+			fseek(clm_file, 0, SEEK_END);
+		}
+	} else if(mpi_rank == 0) {
+		clm_file = fopen(path, "w+b"); // read access needed by OUTPUT_MMAP
+		if(clm_file == NULL) {
+			fprintf(stderr, "\t\tinfo: could not open clm_file %s\n", path);
+		} else {
+			fwrite("LPJCLIM", 7, 1, clm_file);
+			fwrite(header, sizeof(Header),1,clm_file);
+			if(header->version == 3) {
+				fwrite(&header->cellsize, sizeof(float),1,clm_file); // assume cellsize_lat==cellsize_lon
+				fwrite(&datatype, sizeof(int),1,clm_file);
+			}
+			fflush(clm_file);
+		}
+	}
+#ifdef USE_MPI
+	if(mpi_size > 1) {
+		/* other ranks open the file written by rank 0 */
+		if(mpi_rank == 0 && clm_file == NULL)
+			*done_years = -1;
+		MPI_Bcast(done_years, 1, MPI_INT, 0, MPI_COMM_WORLD);
+		if(mpi_rank > 0 && *done_years >= 0) {
+			header->nyear = *done_years;
+			clm_file = fopen(path, "r+b");
+			if(clm_file == NULL)
+				fprintf(stderr, "\t\tinfo: rank %d could not open clm_file %s\n", mpi_rank, path);
+		}
+	}
+#endif
+	if(!all_ranks(clm_file != NULL)) {
+		if(clm_file != NULL)
+			fclose(clm_file);
+		return NULL;
+	}
+	return clm_file;
+} // of 'open_clm_file'
+
+// ***** NetCDF-4 copy of CLM file *****
+
+/* writes the nyear years of the CLM file of v as variable (cell, time) of a
+ * NetCDF-4 file with chunks of opt->nc_chunkcells cells and opt->nc_chunkyears
+ * years, 0 for all. Each chunk is gathered from the mapped CLM file and
+ * written at once, so it is compressed only once. Returns 0 on success */
+static int write_netcdf(const Variable *v, const Grid *grid, const Header *header, int datatype, const Options *opt) {
+	char *ncpath, *map, *data, units[64];
+	const char *name = (v->derived != NULL) ? v->derived->name : v->var;
+	int fd, ncid, status, dims[2], lon_id, lat_id, time_id, var_id, i;
+	int cell, year, c, y, ncell, nyear, *days;
+	size_t valuesize, chunk[2], start[2], count[2];
+	off_t headersize, yearsize, size;
+	float *coord;
+	double seconds = wallclock();
+	struct stat st;
+
+	if(header->nyear < 1)
+		return 0;
+	ncpath = output_path(v->path_to_outfile, ".nc");
+	if(ncpath == NULL) {
+		fprintf(stderr, "Error allocating memory for name of NetCDF file\n");
+		return -1;
+	}
+	valuesize = (datatype == LPJ_FLOAT) ? sizeof(float) : sizeof(short);
+	headersize = 7+sizeof(Header) + ((header->version == 3) ? sizeof(float)+sizeof(int) : 0);
+	yearsize = (off_t)header->ncell*header->nband*valuesize;
+	size = headersize+header->nyear*yearsize;
+	fd = open(v->path_to_outfile, O_RDONLY);
+	map = (fd < 0) ? MAP_FAILED : (char *)mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	if(fd >= 0)
+		close(fd);
+	if(map == MAP_FAILED) {
+		fprintf(stderr, "Error mapping %s for NetCDF copy\n", v->path_to_outfile);
+		free(ncpath);
+		return -1;
+	}
+	chunk[0] = (opt->nc_chunkcells > 0 && opt->nc_chunkcells < header->ncell) ? opt->nc_chunkcells : header->ncell;
+	chunk[1] = (size_t)((opt->nc_chunkyears > 0 && opt->nc_chunkyears < header->nyear) ? opt->nc_chunkyears : header->nyear)*header->nband;
+	data = (char *)malloc(chunk[0]*chunk[1]*valuesize);
+	coord = (float *)malloc(sizeof(float)*header->ncell);
+	days = (int *)malloc(sizeof(int)*header->nyear*header->nband);
+	if(data == NULL || coord == NULL || days == NULL) {
+		fprintf(stderr, "Error allocating memory for NetCDF chunk of %lu values\n", (unsigned long)(chunk[0]*chunk[1]));
+		free(data);
+		free(coord);
+		free(days);
+		munmap(map, size);
+		free(ncpath);
+		return -1;
+	}
+
+	// define dimensions, variables and attributes:
+	status = nc_create(ncpath, NC_CLOBBER|NC_NETCDF4, &ncid);
+	if(status != NC_NOERR) {
+		fprintf(stderr, "Error creating %s: %s\n", ncpath, nc_strerror(status));
+		free(data);
+		free(coord);
+		free(days);
+		munmap(map, size);
+		free(ncpath);
+		return -1;
+	}
+	status = nc_def_dim(ncid, "cell", header->ncell, &dims[0]);
+	if(status == NC_NOERR)
+		status = nc_def_dim(ncid, "time", (size_t)header->nyear*header->nband, &dims[1]);
+	if(status == NC_NOERR)
+		status = nc_def_var(ncid, "lon", NC_FLOAT, 1, &dims[0], &lon_id);
+	if(status == NC_NOERR)
+		status = nc_def_var(ncid, "lat", NC_FLOAT, 1, &dims[0], &lat_id);
+	if(status == NC_NOERR)
+		status = nc_def_var(ncid, "time", NC_INT, 1, &dims[1], &time_id);
+	if(status == NC_NOERR)
+		status = nc_def_var(ncid, name, (datatype == LPJ_FLOAT) ? NC_FLOAT : NC_SHORT, 2, dims, &var_id);
+	if(status == NC_NOERR)
+		status = nc_def_var_chunking(ncid, var_id, NC_CHUNKED, chunk);
+	if(status == NC_NOERR && (opt->nc_deflate > 0 || opt->nc_shuffle))
+		status = nc_def_var_deflate(ncid, var_id, opt->nc_shuffle, opt->nc_deflate > 0, opt->nc_deflate);
+	if(status == NC_NOERR)
+		status = nc_def_var_fill(ncid, var_id, NC_NOFILL, NULL);
+	if(status == NC_NOERR) {
+		snprintf(units, sizeof(units), "days since %d-01-01 00:00:00", header->firstyear);
+		nc_put_att_text(ncid, lon_id, "units", strlen("degrees_east"), "degrees_east");
+		nc_put_att_text(ncid, lat_id, "units", strlen("degrees_north"), "degrees_north");
+		nc_put_att_text(ncid, time_id, "units", strlen(units), units);
+		nc_put_att_text(ncid, time_id, "calendar", strlen("noleap"), "noleap");
+		/* LPJmL multiplies values with scalar when reading CLM files */
+		nc_put_att_float(ncid, var_id, "scale_factor", NC_FLOAT, 1, &header->scalar);
+		nc_put_att_text(ncid, var_id, "coordinates", strlen("lon lat"), "lon lat");
+		/* header of CLM file */
+		nc_put_att_int(ncid, NC_GLOBAL, "clm_version", NC_INT, 1, &header->version);
+		nc_put_att_int(ncid, NC_GLOBAL, "firstyear", NC_INT, 1, &header->firstyear);
+		nc_put_att_int(ncid, NC_GLOBAL, "firstcell", NC_INT, 1, &header->firstcell);
+		nc_put_att_int(ncid, NC_GLOBAL, "nband", NC_INT, 1, &header->nband);
+		nc_put_att_float(ncid, NC_GLOBAL, "cellsize", NC_FLOAT, 1, &header->cellsize);
+		nc_put_att_float(ncid, NC_GLOBAL, "scalar", NC_FLOAT, 1, &header->scalar);
+		status = nc_enddef(ncid);
+	}
+
+	// coordinates:
+	start[0] = 0;
+	count[0] = header->ncell;
+	for(cell=0; cell<header->ncell && status == NC_NOERR; cell++)
+		coord[cell] = grid->data[cell*2]*grid->header.scalar;
+	if(status == NC_NOERR)
+		status = nc_put_vara_float(ncid, lon_id, start, count, coord);
+	for(cell=0; cell<header->ncell && status == NC_NOERR; cell++)
+		coord[cell] = grid->data[cell*2+1]*grid->header.scalar;
+	if(status == NC_NOERR)
+		status = nc_put_vara_float(ncid, lat_id, start, count, coord);
+	for(i=0; i<header->nyear*header->nband; i++)
+		days[i] = i;
+	count[0] = (size_t)header->nyear*header->nband;
+	if(status == NC_NOERR)
+		status = nc_put_vara_int(ncid, time_id, start, count, days);
+
+	// values, one chunk at a time:
+	for(cell=0; cell<header->ncell && status == NC_NOERR; cell+=ncell) {
+		ncell = (header->ncell-cell < chunk[0]) ? header->ncell-cell : (int)chunk[0];
+		for(year=0; year<header->nyear && status == NC_NOERR; year+=nyear) {
+			nyear = (header->nyear-year < chunk[1]/header->nband) ? header->nyear-year : (int)(chunk[1]/header->nband);
+			for(c=0; c<ncell; c++)
+				for(y=0; y<nyear; y++)
+					memcpy(data+(((size_t)c*nyear+y)*header->nband)*valuesize, map+headersize+(year+y)*yearsize+(off_t)(cell+c)*header->nband*valuesize, header->nband*valuesize);
+			start[0] = cell;
+			start[1] = (size_t)year*header->nband;
+			count[0] = ncell;
+			count[1] = (size_t)nyear*header->nband;
+			if(datatype == LPJ_FLOAT)
+				status = nc_put_vara_float(ncid, var_id, start, count, (float *)data);
+			else
+				status = nc_put_vara_short(ncid, var_id, start, count, (short *)data);
+		}
+	}
+	if(status != NC_NOERR)
+		fprintf(stderr, "Error writing %s: %s\n", ncpath, nc_strerror(status));
+	if(nc_close(ncid) != NC_NOERR && status == NC_NOERR)
+		status = -1;
+	if(status == NC_NOERR && stat(ncpath, &st) == 0)
+		fprintf(stdout, "\t\t* NetCDF-4 copy %s: %.1f MB (%.0f%% of CLM file) written in %.2f s, chunks of %lu cells and %lu days\n", ncpath, st.st_size/(1024.0*1024.0),
+			100.0*st.st_size/size, wallclock()-seconds, (unsigned long)chunk[0], (unsigned long)chunk[1]);
+	free(data);
+	free(coord);
+	free(days);
+	munmap(map, size);
+	free(ncpath);
+	return (status == NC_NOERR) ? 0 : -1;
+} // of 'write_netcdf'
+
+/* converts years from startyr of input file number file, which starts with
+ * firstyear, writing them as set in pipe; years outside of v->startyear and
+ * v->endyear are skipped; returns number of years of file converted
+ * including the first startyr years, errors are set in res */
+static int convert_file(const Variable *v, int file, int firstyear, int startyr, Grid *grid, const Options *opt, Pipeline *pipe, Threadpool *pool, Result *res) {
+	Ncfile ncfile, ncfile2;
+	Readplan plan;
+	Yearbuffer *buf;
+	Convertjob *jobs = pool->jobs;
+	pthread_t reader, writer;
+	int status, thread, year;
+	int chunk = 0; // days read at once in streaming mode
+	long long cache; // bytes of chunk caches of input variables
+	size_t cachelimit = NC_CACHE_MAX; // bytes of chunk cache of each input variable
+	int number_yr = 0; // number_yr: number of years in current NetCDF
+	size_t firstday = 0; // first time step of current year in NetCDF
+	int nbuf = pipe->nbuf;
+	int ncells = grid->ncells;
+	short filename_mentioned;
+	float fieldmin, fieldmax;
+	Yearmetrics *ym;
+	long int fill_error, range_error;
+	float qmin, qmax, qerror;
+	double seconds;
+	double read_time = res->timing.read; // to log throughput of reads from this file
+	long long read_bytes = res->timing.read_bytes;
+	
+	plan.seg=NULL;
+	filename_mentioned=0;
+	// some information:
+	fprintf(stdout, "\n\t\tread %d. NetCDF  ...\n",file+1);
+	//fprintf(stdout, "\t\t***************\n\n");
+	fprintf(stdout, "\t\tuse data from: %s\n",v->infiles[file]);
+	
+	// open connection to NetCDF and get parameter of NetCDF:
+	status = open_ncfile(v->infiles[file], v->var, &ncfile);
+	if(status) {
+		if(status == NCFILE_MEMORY_ERROR)
+			res->memory_error=-1;
+		else
+			res->file_error=-1;
+		return 0;
+	}
+	number_yr = (int) (ncfile.time_len/365);
+	if(v->endyear != 0 && firstyear+number_yr-1 > v->endyear)
+		number_yr = (v->endyear >= firstyear) ? v->endyear-firstyear+1 : 0;
+	if(firstyear+number_yr <= v->startyear) {
+		fprintf(stdout, "\t\tyears %d-%d before first year %d\n", firstyear, firstyear+number_yr-1, v->startyear);
+		close_ncfile(&ncfile);
+		return number_yr;
+	}
+	if(startyr < v->startyear-firstyear)
+		startyr = v->startyear-firstyear;
+	if(number_yr <= startyr) {
+		fprintf(stdout, "\t\tyears %d-%d already converted\n", firstyear+((v->startyear > firstyear) ? v->startyear-firstyear : 0), firstyear+number_yr-1);
+		close_ncfile(&ncfile);
+		return number_yr;
+	}
+	if(v->derived != NULL) {
+		fprintf(stdout, "\t\tuse data from: %s\n",v->infiles2[file]);
+		status = open_ncfile(v->infiles2[file], v->var2, &ncfile2);
+		if(status) {
+			if(status == NCFILE_MEMORY_ERROR)
+				res->memory_error=-1;
+			else
+				res->file_error=-1;
+			close_ncfile(&ncfile);
+			return 0;
+		}
+		if(ncfile2.time_len != ncfile.time_len || ncfile2.latlen != ncfile.latlen || ncfile2.lonlen != ncfile.lonlen ||
+				memcmp(ncfile2.nclat, ncfile.nclat, sizeof(double)*ncfile.latlen) || memcmp(ncfile2.nclon, ncfile.nclon, sizeof(double)*ncfile.lonlen)) {
+			fprintf(stderr, "Error: %s and %s do not have the same time steps and coordinates. Aborting.\n", v->infiles[file], v->infiles2[file]);
+			res->file_error=-1;
+			close_ncfile(&ncfile2);
+			close_ncfile(&ncfile);
+			return 0;
+		}
+	}
+	
+	/***** write ilat and ilon *****/
+	res->timing.map -= wallclock();
+	map_grid(grid, &ncfile, opt, res);
+	res->timing.map += wallclock();
+	if(res->grid_error || res->memory_error) {
+		/* stop processing this and any following files */
+		year = 0;
+		goto cleanup;
+	}
+	
+	// determine hyperslabs to read:
+	status = make_plan(&plan, opt->sparse, &ncfile, grid, 366);
+	if(!status && (opt->chunk > 0 || opt->max_mem > 0)) {
+		/* chunk caches count for -max-mem, each variable gets the same part */
+		cache = chunk_cache_size(&ncfile, &plan);
+		if(v->derived != NULL && chunk_cache_size(&ncfile2, &plan) > cache)
+			cache = chunk_cache_size(&ncfile2, &plan);
+		cache *= (v->derived != NULL) ? 2 : 1;
+		chunk = stream_chunk(opt, ncells, nbuf, plan.daysize, (v->derived != NULL) ? 2 : 1, &cache);
+		cachelimit = cache/((v->derived != NULL) ? 2 : 1);
+		if(chunk < 1) {
+			fprintf(stderr, "Error: -max-mem %ld MB is too small for %d cells and %lu grid points per day\n", opt->max_mem, ncells, (unsigned long)plan.daysize);
+			res->memory_error = -1;
+			year = 0;
+			goto cleanup;
+		}
+		/* read whole chunks of the input at once */
+		if(chunk > (int)ncfile.chunk[0] && ncfile.chunk[0] > 1)
+			chunk -= chunk % ncfile.chunk[0];
+		/* values of segments are stored chunk days apart */
+		free(plan.seg);
+		plan.seg = NULL;
+		status = make_plan(&plan, opt->sparse, &ncfile, grid, chunk);
+	}
+	if(status) {
+		fprintf(stderr, "Error allocating memory for read plan\n");
+		res->memory_error = -1;
+		year = 0;
+		goto cleanup;
+	}
+	if(opt->sparse)
+		fprintf(stdout, "\t\tread %d hyperslabs with %lu of %lu grid points per day (%.1f%%)\n", plan.nseg, (unsigned long)plan.daysize, (unsigned long)(ncfile.latlen*ncfile.lonlen), 100.0*plan.daysize/(ncfile.latlen*ncfile.lonlen));
+	tune_chunk_cache(&ncfile, &plan, cachelimit);
+	if(v->derived != NULL)
+		tune_chunk_cache(&ncfile2, &plan, cachelimit);
+	
+	
+	// ***** start of "year"-loop *****
+	
+	// allocate memory for nc_data for one year or one chunk of days:
+	pipe->chunk = chunk;
+	pipe->time_align = (int)ncfile.chunk[0];
+	if(chunk > 0) {
+		fprintf(stdout, "\t\tstreaming: read %d days at once, %.1f MB for values read\n", chunk, (double)sizeof(float)*plan.daysize*chunk*((v->derived != NULL) ? 2 : 1)/(1024*1024));
+		pipe->nc_chunk = (float*)malloc(sizeof(float)*plan.daysize*chunk);
+		if(pipe->nc_chunk == NULL)
+			res->memory_error = -1;
+		if(v->derived != NULL) {
+			pipe->nc_chunk2 = (float*)malloc(sizeof(float)*plan.daysize*chunk);
+			if(pipe->nc_chunk2 == NULL)
+				res->memory_error = -1;
+		}
+	}
+	for(buf=pipe->buf; buf<pipe->buf+nbuf; buf++) {
+		if(chunk == 0) {
+			buf->nc_data = (float*)malloc(sizeof(float)*plan.daysize*366);
+			if(buf->nc_data == NULL)
+				res->memory_error = -1;
+			if(v->derived != NULL) {
+				buf->nc_data2 = (float*)malloc(sizeof(float)*plan.daysize*366);
+				if(buf->nc_data2 == NULL)
+					res->memory_error = -1;
+			}
+		}
+		buf->state = YEAR_FREE;
+	}
+	if(res->memory_error) {
+		fprintf(stderr, "Error allocating memory for nc_data\n");
+		year = 0;
+		goto cleanup;
+	}
+	
+	pipe->firstyear = firstyear;
+	pipe->outyear = firstyear-v->startyear;
+	pipe->number_yr = number_yr;
+	pipe->startyr = startyr;
+	for(pipe->startday=0, year=0; year<startyr; year++)
+		pipe->startday += isleap(firstyear+year) ? 366 : 365;
+	pipe->ncid = ncfile.ncid;
+	pipe->var_id = ncfile.var_id;
+	pipe->derived = v->derived;
+	pipe->fill_value = ncfile.fill_value;
+	if(v->derived != NULL) {
+		pipe->ncid2 = ncfile2.ncid;
+		pipe->var_id2 = ncfile2.var_id;
+		pipe->fill_value2 = ncfile2.fill_value;
+	}
+	pipe->plan = &plan;
+	pipe->nc_base = grid->nc_base;
+	pipe->nc_stride = grid->nc_stride;
+	pipe->gather = select_gather(grid->nc_base, ncells);
+	fprintf(stdout, "\t\tgather values of cells %s\n", (pipe->gather == gather_naive) ? "one after the other (cells in order of input)" : "in blocks (cells not in order of input)");
+	pipe->ncells = ncells;
+	pipe->writefloat = v->writefloat;
+	pipe->quantize = v->quantize;
+	pipe->abort = 0;
+	if(nbuf > 1) {
+		/* reader and writer run concurrently to conversion in this thread */
+		if(pthread_create(&reader, NULL, reader_thread, pipe)) {
+			fprintf(stderr, "Error starting reader thread\n");
+			res->memory_error = -1;
+			year = 0;
+			goto cleanup;
+		}
+		if(pthread_create(&writer, NULL, writer_thread, pipe)) {
+			fprintf(stderr, "Error starting writer thread\n");
+			abort_pipeline(pipe);
+			pthread_join(reader, NULL);
+			res->memory_error = -1;
+			year = 0;
+			goto cleanup;
+		}
+	}
+	
+	firstday = pipe->startday;
+	for(year=startyr; year<number_yr; year++) {
+		buf = &pipe->buf[year % nbuf];
+		fprintf(stdout, "\t\t *** calculate year %d\n",firstyear+year);
+		
+		// read values in nc_data:
+		if(nbuf > 1) {
+			wait_state(pipe, buf, YEAR_READ);
+		} else {
+			read_year(pipe, buf, year, firstday);
+			firstday += buf->time_len;
+		}
+		if(buf->leap_yr)
+			fprintf(stdout, "\t\t *** (leap year)\n");
+		res->timing.read += buf->read_time;
+		res->timing.gather += buf->gather_time;
+		if(buf->status != NC_NOERR) {
+			fprintf(stdout, "\t\tError no.%d: %s\n", buf->status, nc_strerror(buf->status));
+			fprintf(stderr, "Error reading year %d from %s. Aborting.\n", firstyear+year, v->infiles[file]);
+			res->file_error=-1;
+			break;
+		}
+		
+		// ***** process values of NetCDF and write clm-file *****
+		/* each thread converts a contiguous range of cells */
+		for(thread=0; thread<pool->nthreads; thread++) {
+			jobs[thread].firstcell = (int)((long)ncells*thread/pool->nthreads);
+			jobs[thread].lastcell = (int)((long)ncells*(thread+1)/pool->nthreads);
+			jobs[thread].year = firstyear+year;
+			jobs[thread].leap_yr = buf->leap_yr;
+			jobs[thread].time_len = buf->time_len;
+			jobs[thread].nc_data = buf->nc_data;
+			jobs[thread].nc_base = grid->nc_base;
+			jobs[thread].nc_stride = grid->nc_stride;
+			jobs[thread].gather = pipe->gather;
+			jobs[thread].leapval = buf->leapval;
+			jobs[thread].clm_data = buf->clm_data;
+			jobs[thread].clm_writedata_short = buf->clm_writedata_short;
+			jobs[thread].ilon = grid->ilon;
+			jobs[thread].ilat = grid->ilat;
+			jobs[thread].grid_data = grid->data;
+			jobs[thread].grid_scalar = grid->header.scalar;
+			jobs[thread].cell0 = grid->cell0;
+			jobs[thread].filename = v->infiles[file];
+			jobs[thread].offset = v->offset;
+			jobs[thread].convert = v->convert;
+			jobs[thread].fill_value = ncfile.fill_value;
+			jobs[thread].writefloat = v->writefloat;
+			jobs[thread].quantize = v->quantize;
+			jobs[thread].missing = (ncfile.fill_value+v->offset)*v->convert;
+			jobs[thread].qtab = buf->qtab;
+			jobs[thread].aggregates = v->aggregates;
+			jobs[thread].aggr = buf->aggr;
+			jobs[thread].leapday = v->leapday;
+			jobs[thread].checkfill = v->checkfill;
+			jobs[thread].convert_values = opt->kernels->convert[v->checkfill][!v->writefloat];
+			jobs[thread].finish_values = opt->kernels->finish[!v->writefloat];
+			jobs[thread].convert_row = buf->leap_yr ? convert_row_leap[v->leapday] : convert_row_noleap;
+			init_kernelparam(&jobs[thread].param, v->offset, v->convert, ncfile.fill_value);
+			jobs[thread].filename_mentioned = &filename_mentioned;
+			jobs[thread].metrics = pipe->metrics;
+		}
+		run_threadpool(pool);
+		
+		/* reduce results of all threads */
+		fieldmin = jobs[0].fieldmin;
+		fieldmax = jobs[0].fieldmax;
+		fill_error = range_error = 0;
+		ym = year_metrics(pipe->metrics, pipe->outyear+year);
+		if(ym != NULL) {
+			ym->year = firstyear+year;
+			ym->read = buf->read_time;
+			ym->gather = buf->gather_time;
+			ym->read_bytes = (long long)sizeof(float)*plan.daysize*buf->time_len*((v->derived != NULL) ? 2 : 1);
+		}
+		res->timing.read_bytes += (long long)sizeof(float)*plan.daysize*buf->time_len*((v->derived != NULL) ? 2 : 1);
+		res->timing.values += (long long)ncells*365;
+		for(thread=0; thread<pool->nthreads; thread++) {
+			fill_error += jobs[thread].fill_error;
+			range_error += jobs[thread].range_error;
+			res->timing.gather += jobs[thread].gather_time;
+			res->timing.convert += jobs[thread].convert_time;
+			if(ym != NULL) {
+				ym->gather += jobs[thread].gather_time;
+				ym->convert += jobs[thread].convert_time;
+			}
+			if(jobs[thread].fieldmin < fieldmin)
+				fieldmin = jobs[thread].fieldmin;
+			if(jobs[thread].fieldmax > fieldmax)
+				fieldmax = jobs[thread].fieldmax;
+		}
+		res->fill_error += fill_error;
+		res->range_error += range_error;
+		if(ym != NULL) {
+			ym->fill_error = fill_error;
+			ym->range_error = range_error;
+		}
+		if(v->quantize != QUANTIZE_NONE) {
+			qerror = 0;
+			qmin = INFINITY;
+			qmax = -INFINITY;
+			for(thread=0; thread<pool->nthreads; thread++) {
+				if(jobs[thread].qerror > qerror)
+					qerror = jobs[thread].qerror;
+				if(jobs[thread].qmin < qmin)
+					qmin = jobs[thread].qmin;
+				if(jobs[thread].qmax > qmax)
+					qmax = jobs[thread].qmax;
+			}
+			if(v->quantize == QUANTIZE_YEAR) {
+				/* one offset and scale for all cells once their range is known */
+				seconds = wallclock();
+				quantize_factors(qmin, qmax, buf->qtab);
+				qerror = quantize_values(buf->clm_data, (size_t)ncells*365, jobs[0].missing, buf->qtab, buf->clm_writedata_short);
+				seconds = wallclock()-seconds;
+				res->timing.convert += seconds;
+				if(ym != NULL)
+					ym->convert += seconds;
+			}
+			fprintf(stdout, "\t\tLargest quantization error in year %d: %g\n", firstyear+year, qerror*v->scalar);
+			if(qerror > res->quant_error)
+				res->quant_error = qerror;
+		}
+		if(fill_error || range_error)
+			fprintf(stdout, "\t\t%ld NAN or missing values and %ld values out of SHORT range in year %d\n", fill_error, range_error, firstyear+year);
+		if(fieldmax*v->scalar > 1e-1)
+  			fprintf(stdout, "\t\tData range in field: %.2f - %.2f\n", v->writefloat ? fieldmin*v->scalar : roundf(fieldmin)*v->scalar, v->writefloat ? fieldmax*v->scalar : roundf(fieldmax)*v->scalar);
+  		else if(fieldmax*v->scalar > 1e-3)
+  			fprintf(stdout, "\t\tData range in field: %.4f - %.4f\n", v->writefloat ? fieldmin*v->scalar : roundf(fieldmin)*v->scalar, v->writefloat ? fieldmax*v->scalar : roundf(fieldmax)*v->scalar);
+  		else
+  			fprintf(stdout, "\t\tData range in field: %.8f - %.8f\n", v->writefloat ? fieldmin*v->scalar : roundf(fieldmin)*v->scalar, v->writefloat ? fieldmax*v->scalar : roundf(fieldmax)*v->scalar);
+		
+		// write clm-file:
+		if(nbuf > 1) {
+			set_state(pipe, buf, YEAR_CONVERTED);
+		} else {
+			write_year(pipe, buf);
+		}
+		
+	} // end of "year"-loop
+	if(nbuf > 1) {
+		if(year < number_yr)
+			abort_pipeline(pipe);
+		pthread_join(reader, NULL);
+		pthread_join(writer, NULL);
+	}
+	read_time = res->timing.read-read_time;
+	read_bytes = res->timing.read_bytes-read_bytes;
+	if(read_time > 0)
+		fprintf(stdout, "\t\tread %.1f MB of values in %.2f s (%.1f MB/s%s)\n", read_bytes/(1024.0*1024.0), read_time,
+			read_bytes/(1024.0*1024.0)/read_time, ncfile.deflate ? " decompressed" : "");
+	
+	// close file and free allocated memory, also on errors after opening the files:
+cleanup:
+	close_ncfile(&ncfile);
+	if(v->derived != NULL)
+		close_ncfile(&ncfile2);
+	for(buf=pipe->buf; buf<pipe->buf+nbuf; buf++) {
+		free(buf->nc_data);
+		free(buf->nc_data2);
+		buf->nc_data = buf->nc_data2 = NULL;
+	}
+	free(pipe->nc_chunk);
+	free(pipe->nc_chunk2);
+	pipe->nc_chunk = pipe->nc_chunk2 = NULL;
+	free(plan.seg);
+	plan.seg = NULL;
+	return year;
+} // of 'convert_file'
+
+/* returns number of cells with fill values, NaN or values out of range, writes
+ * up to n cells with most of them to worst */
+static int worst_cells(const Metrics *m, int *worst, int n) {
+	int cell, i, j, ncells = 0;
+	for(cell=0; cell<m->ncells; cell++) {
+		if(m->cell_fill[cell]+m->cell_range[cell] == 0)
+			continue;
+		/* insert into sorted list of worst cells */
+		for(i=(ncells < n) ? ncells : n; i>0 && m->cell_fill[worst[i-1]]+m->cell_range[worst[i-1]] < m->cell_fill[cell]+m->cell_range[cell]; i--)
+			;
+		for(j=(ncells < n) ? ncells : n-1; j>i; j--)
+			worst[j] = worst[j-1];
+		if(i < n)
+			worst[i] = cell;
+		ncells++;
+	}
+	return ncells;
+} // of 'worst_cells'
+
+static void print_cells(const Metrics *m, const Grid *grid) {
+	int worst, ncells;
+	if(m->size == 0)
+		return;
+	if(suppressed_messages(m))
+		fprintf(stdout, "\t\t%d further messages about values suppressed (-max-messages %d)\n", suppressed_messages(m), m->max_messages);
+	ncells = worst_cells(m, &worst, 1);
+	if(ncells > 0)
+		fprintf(stdout, "\t\t%d cells with NAN, missing or out of range values, most in cell %d (%.2f°, %.2f°): %d\n", ncells, worst,
+			grid->data[worst*2]*grid->header.scalar, grid->data[worst*2+1]*grid->header.scalar, m->cell_fill[worst]+m->cell_range[worst]);
+} // of 'print_cells'
+
+/* counts years of input files of v, returns number of files that could be opened */
+static int count_years(const Variable *v, int *nyr, Result *res) {
+	Ncfile ncfile;
+	int file, status;
+	for(file=0; file<v->number_infiles; file++) {
+		status = open_ncfile(v->infiles[file], v->var, &ncfile);
+		if(status) {
+			/* files before are converted like in serial run */
+			if(status == NCFILE_MEMORY_ERROR)
+				res->memory_error=-1;
+			else
+				res->file_error=-1;
+			break;
+		}
+		nyr[file] = (int) (ncfile.time_len/365);
+		close_ncfile(&ncfile);
+	}
+	return file;
+} // of 'count_years'
+
+/* converts nfiles input files of v with nyr years in up to opt->nfiles
+ * processes, which write the years of each file to its part of the
+ * preallocated CLM file. Processes are used instead of threads as the NetCDF
+ * library is not thread-safe.
+ * Returns number of years converted without gap from the start */
+static int convert_files(const Variable *v, Grid *grid, const Options *opt, Pipeline *pipe, int done_years, int nfiles, const int *nyr, Result *res) {
+	Threadpool pool;
+	Result *results;
+	int *first, *years, *next;
+	long long *bytes;
+	double *seconds;
+	pid_t *pids;
+	Outfile *outs[MAXOUTPUTS];
+	int file, proc, nproc, status, all_years, i, nout;
+	size_t shared_size;
+	
+	/* results of each file, next file to convert and write statistics of
+	 * each process are shared by all processes */
+	shared_size = (sizeof(Result)+2*sizeof(int))*nfiles + sizeof(int) + (sizeof(long long)+sizeof(double))*opt->nfiles;
+	results = (Result *)mmap(NULL, shared_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	pids = (pid_t *)malloc(sizeof(pid_t)*opt->nfiles);
+	if(results == MAP_FAILED || pids == NULL) {
+		fprintf(stderr, "Error allocating memory for results of files\n");
+		res->memory_error = -1;
+		return done_years;
+	}
+	bytes = (long long *)(results+nfiles);
+	seconds = (double *)(bytes+opt->nfiles);
+	first = (int *)(seconds+opt->nfiles);
+	years = first+nfiles;
+	next = years+nfiles;
+	for(file=0, all_years=0; file<nfiles; file++) {
+		memset(&results[file], 0, sizeof(Result));
+		first[file] = all_years;
+		all_years += nyr[file];
+		years[file] = -1;
+	}
+	*next = 0;
+	nout = list_outputs(pipe, outs);
+	for(i=0; i<nout; i++)
+		outs[i]->positional = 1;
+	
+	nproc = (opt->nfiles < nfiles) ? opt->nfiles : nfiles;
+	fprintf(stdout, "\t\t* converting %d files in %d processes\n", nfiles, nproc);
+	fflush(stdout);
+	fflush(stderr);
+	for(proc=0; proc<nproc; proc++) {
+		pids[proc] = fork();
+		if(pids[proc] < 0) {
+			fprintf(stdout, "\t\tWarning: could only start %d processes\n", proc);
+			break;
+		}
+		if(pids[proc] == 0) {
+			/* threads of parent do not exist in child process */
+			if(init_threadpool(&pool, opt->nthreads))
+				_exit(-1);
+			pthread_mutex_init(&pipe->mutex, NULL);
+			pthread_cond_init(&pipe->cond, NULL);
+			for(i=0; i<nout; i++) {
+				outs[i]->bytes = 0;
+				outs[i]->seconds = 0;
+			}
+			/* files are taken in order by the next free process */
+			while((file = __sync_fetch_and_add(next, 1)) < nfiles) {
+				years[file] = convert_file(v, file, v->firstyear+first[file], (done_years > first[file]) ? done_years-first[file] : 0, grid, opt, pipe, &pool, &results[file]);
+				if(flush_outputs(pipe)) {
+					fprintf(stderr, "Error writing to clm_file %s\n", v->path_to_outfile);
+					results[file].file_error = -1;
+				}
+				if(results[file].grid_error || results[file].file_error || results[file].memory_error)
+					break;
+				fprintf(stdout, "\t\t( NetCDF %d done )\n", file+1);
+			}
+			bytes[proc] = 0;
+			seconds[proc] = 0;
+			for(i=0; i<nout; i++) {
+				bytes[proc] += outs[i]->bytes;
+				seconds[proc] += outs[i]->seconds;
+			}
+			free_threadpool(&pool);
+			/* buffers of other streams like the metrics report belong to the parent */
+			fflush(stdout);
+			fflush(stderr);
+			_exit(0);
+		}
+	}
+	for(nproc=proc, proc=0; proc<nproc; proc++) {
+		if(waitpid(pids[proc], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status)) {
+			fprintf(stderr, "Error: process converting files terminated abnormally\n");
+			res->memory_error = -1;
+		}
+		/* processes write at the same time */
+		pipe->out->bytes += bytes[proc];
+		if(seconds[proc] > pipe->out->seconds)
+			pipe->out->seconds = seconds[proc];
+	}
+	
+	/* reduce results of all files, only years up to the first gap are kept */
+	for(file=0; file<nfiles; file++) {
+		if(results[file].grid_error)
+			res->grid_error = results[file].grid_error;
+		if(results[file].file_error)
+			res->file_error = results[file].file_error;
+		if(results[file].memory_error)
+			res->memory_error = results[file].memory_error;
+		res->fill_error += results[file].fill_error;
+		res->range_error += results[file].range_error;
+		if(results[file].quant_error > res->quant_error)
+			res->quant_error = results[file].quant_error;
+		res->timing.map += results[file].timing.map;
+		res->timing.read += results[file].timing.read;
+		res->timing.gather += results[file].timing.gather;
+		res->timing.convert += results[file].timing.convert;
+		res->timing.read_bytes += results[file].timing.read_bytes;
+		res->timing.values += results[file].timing.values;
+	}
+	for(file=0, all_years=0; file<nfiles && years[file] >= 0; file++) {
+		all_years = first[file]+years[file];
+		if(years[file] < nyr[file])
+			break;
+	}
+	if(all_years < done_years)
+		all_years = done_years;
+	munmap(results, shared_size);
+	free(pids);
+	return all_years;
+} // of 'convert_files'
+
+#ifdef USE_MPI
+/* sums results and metrics of all ranks, time spent writing is the maximum as ranks write at the same time */
+static void reduce_ranks(Result *res, Metrics *m, Outfile *out) {
+	short errors[3] = {res->grid_error, res->file_error, res->memory_error};
+	long int counts[2] = {res->fill_error, res->range_error};
+	double *years;
+	int year, *yearnumbers;
+	MPI_Allreduce(MPI_IN_PLACE, errors, 3, MPI_SHORT, MPI_MIN, MPI_COMM_WORLD);
+	res->grid_error = errors[0];
+	res->file_error = errors[1];
+	res->memory_error = errors[2];
+	MPI_Allreduce(MPI_IN_PLACE, counts, 2, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+	res->fill_error = counts[0];
+	res->range_error = counts[1];
+	MPI_Allreduce(MPI_IN_PLACE, &res->quant_error, 1, MPI_FLOAT, MPI_MAX, MPI_COMM_WORLD);
+	MPI_Allreduce(MPI_IN_PLACE, &res->timing.map, 4, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD); // map, read, gather, convert
+	MPI_Allreduce(MPI_IN_PLACE, &res->timing.read_bytes, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+	MPI_Allreduce(MPI_IN_PLACE, &res->timing.values, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+	MPI_Allreduce(MPI_IN_PLACE, &out->bytes, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+	MPI_Allreduce(MPI_IN_PLACE, &out->seconds, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+	MPI_Allreduce(MPI_IN_PLACE, m->messages, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+	MPI_Allreduce(MPI_IN_PLACE, m->cell_fill, 2*m->ncells, MPI_INT, MPI_SUM, MPI_COMM_WORLD); // cell_fill and cell_range
+	if(m->nyear == 0)
+		return;
+	/* per year: year converted by any rank, sums of times, bytes and counts */
+	years = (double *)malloc(sizeof(double)*8*m->nyear);
+	yearnumbers = (int *)malloc(sizeof(int)*m->nyear);
+	if(years == NULL || yearnumbers == NULL) {
+		fprintf(stderr, "Error allocating memory for metrics of years\n");
+		res->memory_error = -1;
+		free(years);
+		free(yearnumbers);
+		return;
+	}
+	for(year=0; year<m->nyear; year++) {
+		yearnumbers[year] = m->years[year].year;
+		years[8*year] = m->years[year].read;
+		years[8*year+1] = m->years[year].gather;
+		years[8*year+2] = m->years[year].convert;
+		years[8*year+3] = m->years[year].write;
+		years[8*year+4] = m->years[year].read_bytes;
+		years[8*year+5] = m->years[year].write_bytes;
+		years[8*year+6] = m->years[year].fill_error;
+		years[8*year+7] = m->years[year].range_error;
+	}
+	MPI_Allreduce(MPI_IN_PLACE, yearnumbers, m->nyear, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+	MPI_Allreduce(MPI_IN_PLACE, years, 8*m->nyear, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+	for(year=0; year<m->nyear; year++) {
+		m->years[year].year = yearnumbers[year];
+		m->years[year].read = years[8*year];
+		m->years[year].gather = years[8*year+1];
+		m->years[year].convert = years[8*year+2];
+		m->years[year].write = years[8*year+3];
+		m->years[year].read_bytes = (long long)years[8*year+4];
+		m->years[year].write_bytes = (long long)years[8*year+5];
+		m->years[year].fill_error = (long int)years[8*year+6];
+		m->years[year].range_error = (long int)years[8*year+7];
+	}
+	free(years);
+	free(yearnumbers);
+} // of 'reduce_ranks'
+
+/* converts nfiles input files of v with nyr years split between MPI ranks:
+ * with SPLIT_YEARS rank r converts files r, r+mpi_size, ..., with SPLIT_CELLS
+ * each rank converts a contiguous range of cells of all files. Ranks write
+ * their part of the preallocated CLM file.
+ * Returns number of years converted by all ranks without gap from the start */
+static int convert_ranks(const Variable *v, Grid *grid, const Options *opt, Pipeline *pipe, Threadpool *pool, int done_years, int nfiles, const int *nyr, Result *res) {
+	Grid part;
+	Outfile *outs[MAXOUTPUTS];
+	int file, firstyear, year, all_years, *first, *years;
+	int cell0, ncells, i, nout;
+	first = (int *)malloc(sizeof(int)*nfiles);
+	years = (int *)malloc(sizeof(int)*nfiles);
+	if(!all_ranks(first != NULL && years != NULL)) {
+		fprintf(stderr, "Error allocating memory for list of files\n");
+		res->memory_error = -1;
+		free(first);
+		free(years);
+		return done_years;
+	}
+	for(file=0, all_years=0; file<nfiles; file++) {
+		first[file] = all_years;
+		all_years += nyr[file];
+		years[file] = -1;
+	}
+	nout = list_outputs(pipe, outs);
+	for(i=0; i<nout; i++)
+		outs[i]->positional = 1;
+	if(opt->split == SPLIT_YEARS) {
+		fprintf(stdout, "\t\t* rank %d of %d converts every %d. file starting with file %d\n", mpi_rank, mpi_size, mpi_size, mpi_rank+1);
+		for(file=mpi_rank; file<nfiles; file+=mpi_size) {
+			years[file] = convert_file(v, file, v->firstyear+first[file], (done_years > first[file]) ? done_years-first[file] : 0, grid, opt, pipe, pool, res);
+			if(res->grid_error || res->file_error || res->memory_error)
+				break;
+			fprintf(stdout, "\t\t( NetCDF %d done )\n", file+1);
+		}
+		/* only years up to the first gap are kept */
+		MPI_Allreduce(MPI_IN_PLACE, years, nfiles, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+		for(file=0, all_years=0; file<nfiles && years[file] >= 0; file++) {
+			all_years = first[file]+years[file];
+			if(years[file] < nyr[file])
+				break;
+		}
+	} else {
+		cell0 = (int)((long)grid->ncells*mpi_rank/mpi_size);
+		ncells = (int)((long)grid->ncells*(mpi_rank+1)/mpi_size)-cell0;
+		fprintf(stdout, "\t\t* rank %d of %d converts cells %d-%d\n", mpi_rank, mpi_size, cell0, cell0+ncells-1);
+		if(!all_ranks(!part_grid(&part, grid, cell0, ncells))) {
+			fprintf(stderr, "Error allocating memory for cells of rank %d\n", mpi_rank);
+			res->memory_error = -1;
+			free(first);
+			free(years);
+			return done_years;
+		}
+		/* all outputs hold values of each cell, -quantize year is not possible */
+		for(i=0; i<nout; i++) {
+			outs[i]->sliceoffset = (off_t)cell0*(outs[i]->yearsize/grid->ncells);
+			outs[i]->slicesize = (size_t)ncells*(outs[i]->yearsize/grid->ncells);
+		}
+		firstyear = v->firstyear;
+		for(file=0, all_years=0; file<nfiles; file++) {
+			year = convert_file(v, file, firstyear, (done_years > all_years) ? done_years-all_years : 0, &part, opt, pipe, pool, res);
+			firstyear += year;
+			all_years += year;
+			if(res->grid_error || res->file_error || res->memory_error)
+				break;
+			fprintf(stdout, "\t\t( current NetCDF done )\n");
+		}
+		/* years written by all ranks */
+		MPI_Allreduce(MPI_IN_PLACE, &all_years, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+		free_grid(&part);
+	}
+	if(flush_outputs(pipe)) {
+		fprintf(stderr, "Error writing to clm_file %s\n", v->path_to_outfile);
+		res->file_error = -1;
+	}
+	if(all_years < done_years)
+		all_years = done_years;
+	free(first);
+	free(years);
+	return all_years;
+} // of 'convert_ranks'
+#endif
+
+/* opens further output of a variable named path, which is resumed to the
+ * done_years years of the CLM file; returns 0 on success, errors are set in res */
+static int open_output(Outfile *out, const char *path, Header *header, int datatype, const Options *opt, int done_years, Result *res) {
+	FILE *file;
+	int done;
+	file = (path == NULL) ? NULL : open_clm_file(path, header, datatype, opt->resume, done_years, &done);
+	if(file != NULL && done < done_years) {
+		fprintf(stderr, "Error: %s holds only %d of %d years, cannot resume\n", path, done, done_years);
+		fclose(file);
+		file = NULL;
+	}
+	if(file == NULL) {
+		res->file_error = -1;
+		return -1;
+	}
+	if(!all_ranks(!init_outfile(out, opt->output, file, header, datatype))) {
+		fprintf(stderr, "Error allocating memory for output block\n");
+		fclose(file);
+		res->memory_error = -1;
+		return -1;
+	}
+	out->owner = (mpi_rank == 0);
+	return 0;
+} // of 'open_output'
+
+/* closes CLM file and further outputs */
+static int close_outputs(const Pipeline *pipe, int nyear) {
+	Outfile *outs[MAXOUTPUTS];
+	int i, n = list_outputs(pipe, outs), status = 0;
+	for(i=0; i<n; i++)
+		if(close_outfile(outs[i], nyear))
+			status = -1;
+	return status;
+} // of 'close_outputs'
+
+/* sets size of CLM file and further outputs to nyear years, returns 0 on success */
+static int preallocate_outputs(const Pipeline *pipe, int nyear) {
+	Outfile *outs[MAXOUTPUTS];
+	int i, n = list_outputs(pipe, outs);
+	for(i=0; i<n; i++)
+		if(preallocate_outfile(outs[i], nyear))
+			return -1;
+	return 0;
+} // of 'preallocate_outputs'
+
+/* converts all input files of one variable into one CLM file */
+static void convert_variable(const Variable *v, Grid *grid, const Options *opt, Pipeline *pipe, Threadpool *pool, Result *res, Metrics *metrics) {
+	Header clm_header, qheader, aheader[NAGGR];
+	FILE *clm_file;
+	Outfile out, qout, aout[NAGGR], *outs[MAXOUTPUTS];
+	char *qpath = NULL, *path, suffix[32];
+	int file, year, nfiles, preallocate, output, i, nout, *nyr = NULL;
+	int firstyear = v->firstyear;
+	int all_years = 0; // whole number of years in clm-file
+	int done_years = 0; // years already converted in resumed clm-file
+	int skip = v->startyear-v->firstyear; // years of input before first year of clm-file
+	int nbuf = pipe->nbuf;
+	int ncells = grid->ncells;
+	int datatype = (v->writefloat && !v->quantize) ? LPJ_FLOAT : LPJ_SHORT;
+	
+	pipe->qout = NULL;
+	for(output=0; output<NAGGR; output++)
+		pipe->aggr_out[output] = NULL;
+	fprintf(stdout,"\t\t###############################\n");
+	fprintf(stdout, "\t\t* number of infiles: %d\n", v->number_infiles);
+	fprintf(stdout, "\t\t* var: %s\n", v->var);
+	fprintf(stdout, "\t\t* firstyear: %d\n", v->firstyear);
+	if(skip > 0 || v->endyear != 0) {
+		if(v->endyear != 0)
+			fprintf(stdout, "\t\t* years written: %d-%d\n", v->startyear, v->endyear);
+		else
+			fprintf(stdout, "\t\t* years written: from %d\n", v->startyear);
+	}
+	fprintf(stdout, "\t\t* path to gridfile: %s (ncells=%d)\n",grid->path, ncells);
+	fprintf(stdout, "\t\t* offset (add): %f\n", v->offset);
+	fprintf(stdout, "\t\t* convert units (mult): %f\n", v->convert);
+	fprintf(stdout, "\t\t* scalar factor applied when read into LPJ (no change): %f\n", v->scalar);
+	fprintf(stdout, "\t\t* path to outfile: %s\n\n",v->path_to_outfile);
+  if(v->quantize) {
+    fprintf(stdout, "\t\t* outfile will be created as CLM type 3 with data type LPJ_SHORT quantized with offset and scale of each %s\n", (v->quantize == QUANTIZE_CELL) ? "cell and year" : "year");
+  } else if(v->writefloat) {
+    fprintf(stdout, "\t\t* outfile will be created as CLM type 3 with data type LPJ_FLOAT\n");
+  }
+  if(pool->nthreads > 1) {
+    fprintf(stdout, "\t\t* number of threads: %d\n", pool->nthreads);
+  }
+  fprintf(stdout, "\t\t* conversion kernels: %s\n", opt->kernels->name);
+  fprintf(stdout, "\t\t* leap day: %s\n", (v->leapday == LEAPDAY_REDISTRIBUTE) ? "distributed over february" : "dropped");
+  if(!v->checkfill) {
+    fprintf(stdout, "\t\t* fill values and NaN are not reported\n");
+  }
+  if(nbuf > 1) {
+    fprintf(stdout, "\t\t* pipelined with %d year buffers\n", nbuf);
+  }
+  if(opt->output != OUTPUT_STDIO) {
+    fprintf(stdout, "\t\t* output written with %s\n", output_methods[opt->output]);
+  }
+  if(v->derived != NULL) {
+    fprintf(stdout, "\t\t* derived variable %s from %s and %s: %s\n", v->derived->name, v->var, v->var2, v->derived->description);
+  }
+  if(v->convert==0.0) {
+    fprintf(stdout,"\t\t* Warning: You have set convert to 0.0 which will set all values to zero in CLM file.\n");
+  }
+  if(v->scalar==0.0) {
+    fprintf(stdout,"\t\t* Warning: You have set scalar to 0.0 which will prompt LPJmL to multiply all CLM file values by zero when reading.\n");
+  }
+	
+	// ***** write header of clm-file *****
+	
+	// collect headerdata:
+  if(v->writefloat) {
+    clm_header.version = 3;
+  } else {
+    clm_header.version = 2;
+  }
+	clm_header.order = 1;
+	clm_header.firstyear = v->startyear;
+	clm_header.nyear = 0;
+	clm_header.firstcell = grid->header.firstcell; 
+	clm_header.ncell = grid->header.ncell;
+	clm_header.nband = 365;
+	clm_header.cellsize = grid->header.cellsize;
+	clm_header.scalar = v->scalar;
+	
+	
+	// resume existing clm-file or write header to new clm-file, only rank 0 writes the header:
+	clm_file = open_clm_file(v->path_to_outfile, &clm_header, datatype, opt->resume, -1, &done_years);
+	if(clm_file == NULL) {
+		res->file_error = -1;
+		return;
+	}
+	
+	if(!all_ranks(!init_outfile(&out, opt->output, clm_file, &clm_header, datatype))) {
+		fprintf(stderr, "Error allocating memory for output block\n");
+		fclose(clm_file);
+		res->memory_error = -1;
+		return;
+	}
+	out.owner = (mpi_rank == 0);
+	pipe->out = &out;
+	
+	/* offset and scale of quantized values, one pair per cell and year or per year */
+	if(v->quantize) {
+		qheader = clm_header;
+		qheader.version = 3;
+		qheader.nyear = 0;
+		if(v->quantize == QUANTIZE_YEAR) {
+			qheader.firstcell = 0;
+			qheader.ncell = 1;
+		}
+		qheader.nband = 2;
+		qheader.scalar = 1;
+		qpath = output_path(v->path_to_outfile, ".factors.clm");
+		if(open_output(&qout, qpath, &qheader, LPJ_FLOAT, opt, done_years, res)) {
+			free(qpath);
+			close_outputs(pipe, done_years);
+			return;
+		}
+		pipe->qout = &qout;
+	}
+	
+	/* monthly and annual aggregates of the converted values of each cell */
+	for(output=0; output<NAGGR; output++) {
+		if(!(v->aggregates & (1 << output)))
+			continue;
+		aheader[output] = clm_header;
+		aheader[output].version = 3;
+		aheader[output].nyear = 0;
+		aheader[output].nband = aggr_bands[output/NSTATS];
+		snprintf(suffix, sizeof(suffix), ".%s_%s.clm", aggr_periods[output/NSTATS], aggr_stats[output%NSTATS]);
+		path = output_path(v->path_to_outfile, suffix);
+		if(open_output(&aout[output], path, &aheader[output], LPJ_FLOAT, opt, done_years, res)) {
+			free(path);
+			free(qpath);
+			close_outputs(pipe, done_years);
+			return;
+		}
+		fprintf(stdout, "\t\t* %s %s written to %s\n", aggr_periods[output/NSTATS], aggr_stats[output%NSTATS], path);
+		free(path);
+		pipe->aggr_out[output] = &aout[output];
+	}
+	
+	/* preallocate output if years are written out of order or not appended,
+	 * metrics of each year need the number of years as well */
+	nfiles = v->number_infiles;
+	preallocate = opt->output != OUTPUT_STDIO || (opt->nfiles > 1 && v->number_infiles > 1) || mpi_size > 1;
+	if(preallocate || opt->metrics != NULL) {
+		nyr = (int *)malloc(sizeof(int)*v->number_infiles);
+		if(!all_ranks(nyr != NULL)) {
+			fprintf(stderr, "Error allocating memory for list of files\n");
+			res->memory_error = -1;
+			free(nyr);
+			close_outputs(pipe, done_years);
+			free(qpath);
+			return;
+		}
+		nfiles = count_years(v, nyr, res);
+		/* files after -endyear are not opened again */
+		for(file=0, all_years=0; file<nfiles && (v->endyear == 0 || v->firstyear+all_years <= v->endyear); file++)
+			all_years += nyr[file];
+		nfiles = file;
+		if(v->endyear != 0 && v->firstyear+all_years-1 > v->endyear)
+			all_years = v->endyear-v->firstyear+1;
+		all_years = (all_years > skip) ? all_years-skip : 0;
+		if(!all_ranks(!preallocate || !preallocate_outputs(pipe, (all_years > done_years) ? all_years : done_years))) {
+			fprintf(stderr, "Error allocating %lld bytes for %s\n", (long long)out.size, v->path_to_outfile);
+			res->file_error = -1;
+			free(nyr);
+			close_outputs(pipe, done_years);
+			free(qpath);
+			return;
+		}
+	}
+	if(!all_ranks(!init_metrics(metrics, opt->max_messages, ncells, (opt->metrics != NULL) ? all_years : 0))) {
+		fprintf(stderr, "Error allocating memory for metrics\n");
+		res->memory_error = -1;
+		free(nyr);
+		close_outputs(pipe, done_years);
+		free(qpath);
+		return;
+	}
+	pipe->metrics = metrics;
+	all_years = 0;
+	
+	/***** start of "file"-loop (to combine the different NetCDF-files) ****
+	 ***********************************************************************/
+	
+#ifdef USE_MPI
+	if(mpi_size > 1) {
+		all_years = convert_ranks(v, grid, opt, pipe, pool, done_years+skip, nfiles, nyr, res);
+	} else
+#endif
+	if(opt->nfiles > 1 && v->number_infiles > 1) {
+		all_years = convert_files(v, grid, opt, pipe, done_years+skip, nfiles, nyr, res);
+	} else {
+	for (file=0; file<nfiles && (v->endyear == 0 || firstyear <= v->endyear); file++) {
+		/* first years of file may already be converted */
+		year = convert_file(v, file, firstyear, (done_years+skip > all_years) ? done_years+skip-all_years : 0, grid, opt, pipe, pool, res);
+		
+		// update firstyear of next NetCDF-file and count all years in clm-file:
+		firstyear+=year;
+		all_years +=year;
+		if(res->grid_error || res->file_error || res->memory_error) {
+			/* stop processing any following files */
+			break;
+		}
+		
+		fprintf(stdout, "\t\t( current NetCDF done )\n");
+	} // end of "file"-loop
+	}
+	free(nyr);
+	/* years of input before -startyear are not in clm-file */
+	all_years = (all_years > skip) ? all_years-skip : 0;
+	
+	// rewrite nyears in clm-header, rank 0 after all ranks have written their part:
+	if(mpi_rank > 0 && close_outputs(pipe, all_years)) {
+		fprintf(stderr, "Error writing clm_file %s\n", v->path_to_outfile);
+		res->file_error = -1;
+	}
+	wait_ranks();
+	if(mpi_rank == 0 && close_outputs(pipe, all_years)) {
+		fprintf(stderr, "Error writing clm_file %s\n", v->path_to_outfile);
+		res->file_error = -1;
+	}
+	/* further outputs count as output of the variable */
+	nout = list_outputs(pipe, outs);
+	for(i=1; i<nout; i++) {
+		out.bytes += outs[i]->bytes;
+		out.seconds += outs[i]->seconds;
+	}
+	pipe->qout = NULL;
+	for(output=0; output<NAGGR; output++)
+		pipe->aggr_out[output] = NULL;
+#ifdef USE_MPI
+	if(mpi_size > 1)
+		reduce_ranks(res, metrics, &out);
+#endif
+	if(out.seconds > 0 && mpi_rank == 0)
+		fprintf(stdout, "\t\t* output %s: %.1f MB written in %.2f s (%.1f MB/s)\n", output_methods[out.method], out.bytes/(1024.0*1024.0), out.seconds, out.bytes/(1024.0*1024.0)/out.seconds);
+	if(v->quantize && mpi_rank == 0)
+		fprintf(stdout, "\t\t* offset and scale written to %s, largest quantization error: %g\n", qpath, res->quant_error*v->scalar);
+	free(qpath);
+	res->timing.write = out.seconds;
+	res->timing.write_bytes = out.bytes;
+	res->nyear = all_years;
+	if(opt->netcdf && mpi_rank == 0 && v->quantize)
+		fprintf(stdout, "\t\t* no NetCDF-4 copy of quantized values written\n");
+	else if(opt->netcdf && mpi_rank == 0 && !res->grid_error && !res->file_error && !res->memory_error &&
+	   write_netcdf(v, grid, &clm_header, datatype, opt))
+		res->file_error = -1;
+	if(mpi_rank == 0)
+		print_cells(metrics, grid);
+} // of 'convert_variable'
+
+static void print_result(const Result *res) {
+	if(res->grid_error) {
+		fprintf(stdout, "\t\tProgram aborted prematurely because of grid error\n");
+		fprintf(stderr, "Program aborted prematurely because of grid error\n");
+	}
+	if(res->file_error) {
+		fprintf(stderr, "Program aborted prematurely because of NetCDF file error\n");
+		fprintf(stdout, "\t\tProgram aborted prematurely because of NetCDF file error\n");
+	}
+	if(res->memory_error) {
+		fprintf(stderr, "Program aborted prematurely because of memory error\n");
+		fprintf(stdout, "\t\tProgram aborted prematurely because of memory error\n");
+	}
+	if(res->fill_error)
+		fprintf(stdout, "\t\tProgram encountered %ld NAN or missing values.\n", res->fill_error);
+	if(res->range_error)
+		fprintf(stdout, "\t\tProgram encountered %ld values out of SHORT range, not incl. possible NAN or missing values\n", res->range_error);
+} // of 'print_result'
+
+/* one line of key=value pairs, read by bench_nc2clm.sh */
+static void print_timing(const Timing *t) {
+	fprintf(stdout, "\t\t* timing: map=%.4f read=%.4f gather=%.4f convert=%.4f write=%.4f values=%lld read_bytes=%lld write_bytes=%lld\n",
+		t->map, t->read, t->gather, t->convert, t->write, t->values, t->read_bytes, t->write_bytes);
+} // of 'print_timing'
+
+static int result_status(const Result *res) {
+	if(res->grid_error)
+		return res->grid_error;
+	if(res->file_error)
+		return res->file_error;
+	if(res->memory_error)
+		return res->memory_error;
+	if(res->fill_error || res->range_error)
+		return -1;
+	return 0;
+}
+
+static void write_jsonstring(FILE *file, const char *str) {
+	fputc('"', file);
+	for(; *str != '\0'; str++) {
+		if(*str == '"' || *str == '\\')
+			fputc('\\', file);
+		fputc(*str, file);
+	}
+	fputc('"', file);
+}
+
+#define METRICS_CELLS 10 // cells with most errors listed in JSON report
+
+/* writes metrics of variable as element of JSON array */
+static void write_metrics(FILE *file, const Variable *v, const Grid *grid, const Result *res, const Metrics *m, double seconds, int first) {
+	const Timing *t = &res->timing;
+	int worst[METRICS_CELLS], i, year, ncells;
+	fprintf(file, "%s    {\n      \"outfile\": ", first ? "" : ",\n");
+	write_jsonstring(file, v->path_to_outfile);
+	fprintf(file, ",\n      \"var\": ");
+	write_jsonstring(file, v->var);
+	fprintf(file, ",\n      \"ncells\": %d,\n      \"years\": %d,\n      \"status\": %d,\n", grid->ncells, res->nyear, result_status(res));
+	fprintf(file, "      \"seconds\": %.4f,\n      \"stages\": {\"map\": %.4f, \"read\": %.4f, \"gather\": %.4f, \"convert\": %.4f, \"write\": %.4f},\n",
+		seconds, t->map, t->read, t->gather, t->convert, t->write);
+	fprintf(file, "      \"values\": %lld,\n      \"bytes_read\": %lld,\n      \"bytes_written\": %lld,\n", t->values, t->read_bytes, t->write_bytes);
+	fprintf(file, "      \"fill_values\": %ld,\n      \"range_errors\": %ld,\n      \"messages_suppressed\": %d,\n",
+		res->fill_error, res->range_error, suppressed_messages(m));
+	if(v->quantize)
+		fprintf(file, "      \"quantization_error\": %g,\n", res->quant_error*v->scalar);
+	ncells = (m->size > 0) ? worst_cells(m, worst, METRICS_CELLS) : 0;
+	fprintf(file, "      \"cells_with_errors\": %d,\n      \"worst_cells\": [", ncells);
+	for(i=0; i<ncells && i<METRICS_CELLS; i++)
+		fprintf(file, "%s\n        {\"cell\": %d, \"lon\": %.2f, \"lat\": %.2f, \"fill_values\": %d, \"range_errors\": %d}", (i > 0) ? "," : "", worst[i],
+			grid->data[worst[i]*2]*grid->header.scalar, grid->data[worst[i]*2+1]*grid->header.scalar, m->cell_fill[worst[i]], m->cell_range[worst[i]]);
+	fprintf(file, "%s],\n      \"per_year\": [", (ncells > 0) ? "\n      " : "");
+	for(year=0, i=0; year<m->nyear && m->size > 0; year++) {
+		if(m->years[year].year == 0)
+			continue; // not converted in this run
+		fprintf(file, "%s\n        {\"year\": %d, \"read\": %.4f, \"gather\": %.4f, \"convert\": %.4f, \"write\": %.4f, \"bytes_read\": %lld, \"bytes_written\": %lld, \"fill_values\": %ld, \"range_errors\": %ld}",
+			(i++ > 0) ? "," : "", m->years[year].year, m->years[year].read, m->years[year].gather, m->years[year].convert, m->years[year].write,
+			m->years[year].read_bytes, m->years[year].write_bytes, m->years[year].fill_error, m->years[year].range_error);
+	}
+	fprintf(file, "%s]\n    }", (i > 0) ? "\n      " : "");
+} // of 'write_metrics'
+
+// ***** start of program *****
+int main(int argc, char *argv[0]) // *1
+{
+	
+	
+	// ***** variables *****
+	Options opt;
+	Variable *vars;
+	Grid grid;
+	Pipeline pipe;
+	Yearbuffer *buf;
+	Threadpool pool;
+	Result res;
+	Metrics metrics;
+	double start;
+	int arg, i, nvar, output, status;
+	char *path_to_gridfile;
+#ifdef USE_MPI
+	int provided;
+	
+	/* the main thread calls MPI, with -pipeline the reader thread reads files
+	 * opened by nc_open_par, which are serialized with the main thread */
+	MPI_Init_thread(&argc, &argv, MPI_THREAD_SERIALIZED, &provided);
+	MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &mpi_size);
+#endif
+	
+	/* initialization */
+	opt.nthreads = 1;
+	opt.sparse = 0;
+	opt.nbuf = 1;
+	opt.chunk = 0;
+	opt.resume = 0;
+	opt.nfiles = 1;
+	opt.output = OUTPUT_STDIO;
+	opt.timing = 0;
+	opt.max_messages = 1000;
+	opt.metrics = NULL;
+	opt.split = -1;
+	opt.netcdf = 0;
+	opt.nc_chunkcells = 1024;
+	opt.nc_chunkyears = 0;
+	opt.nc_deflate = 4;
+	opt.nc_shuffle = 1;
+	opt.max_mem = 0;
+	opt.mapcache_dir = NULL;
+	opt.kernels = select_kernels(NULL);
+	status = 0;
+	
+	
+	// ***** assign Arguments *****
+	if(argc > 1 && strcmp(argv[1], "-spec") == 0) {
+		/* several variables listed in spec file */
+		if(argc < 4)
+			usage(argv[0]);
+		path_to_gridfile = argv[3];
+		for(arg=4; arg<argc; arg++)
+			if(!parse_option(argc, argv, &arg, &opt, argv[0]))
+				fprintf(stdout, "\t\tUnknown argument %s\n", argv[arg]);
+		nvar = read_spec(argv[2], &vars, argv[0]);
+		if(nvar < 0)
+			usage(argv[0]);
+		fprintf(stdout, "\t\t* spec file %s lists %d variables\n", argv[2], nvar);
+	} else {
+		if(argc < 10)
+			usage(argv[0]);
+		vars = (Variable *)malloc(sizeof(Variable));
+		if(vars == NULL || parse_variable(argc-1, argv+1, vars, &path_to_gridfile, &opt, argv[0]))
+			usage(argv[0]);
+		nvar = 1;
+	}
+	
+	
+	if(mpi_size > 1 && opt.split < 0) {
+		fprintf(stderr, "Started with %d MPI ranks, -mpi cells|years is needed\n", mpi_size);
+		exit(-1);
+	}
+	nc_parallel = (mpi_size > 1 && opt.split == SPLIT_CELLS);
+#ifdef USE_MPI
+	if(provided < MPI_THREAD_FUNNELED) {
+		fprintf(stderr, "MPI library does not support threads\n");
+		exit(-1);
+	}
+#ifdef NC_PARALLEL
+	if(nc_parallel && opt.nbuf > 1 && provided < MPI_THREAD_SERIALIZED) {
+		fprintf(stderr, "-pipeline with -mpi cells needs MPI_THREAD_SERIALIZED, which the MPI library does not support\n");
+		exit(-1);
+	}
+#endif
+#endif
+	if(mpi_size > 1 && opt.nfiles > 1 && mpi_rank == 0)
+		fprintf(stdout, "\t\t-files %d is ignored with -mpi\n", opt.nfiles);
+	for(i=0; i<nvar; i++)
+		if(nc_parallel && vars[i].quantize == QUANTIZE_YEAR) {
+			fprintf(stderr, "-quantize year needs all cells of a year, use -mpi years or -quantize cell\n");
+			exit(-1);
+		}
+	
+	
+	// ***** LPJmL grid-file *****
+	read_grid(path_to_gridfile, &grid);
+	
+	if(opt.nthreads > grid.ncells)
+		opt.nthreads = (grid.ncells > 0) ? grid.ncells : 1;
+	if(init_threadpool(&pool, opt.nthreads)) {
+		fprintf(stderr, "Error allocating memory for threads\n");
+		exit(-1);
+	}
+	
+	/* memory for nbuf years of LPJ data, memory for NetCDF data is allocated per file */
+	pipe.buf = (Yearbuffer *)calloc(opt.nbuf, sizeof(Yearbuffer));
+	if(pipe.buf == NULL) {
+		fprintf(stderr, "Error allocating memory for year buffers\n");
+		exit(-1);
+	}
+	pipe.nbuf = opt.nbuf;
+	pipe.nc_chunk = pipe.nc_chunk2 = NULL;
+	for(buf=pipe.buf; buf<pipe.buf+opt.nbuf; buf++) {
+		buf->clm_data = (float *)malloc(sizeof(float)*grid.ncells*365); 
+		buf->clm_writedata_short = (short *)malloc(sizeof(short)*grid.ncells*365);
+		buf->leapval = (float *)malloc(sizeof(float)*grid.ncells);
+		buf->qtab = (float *)malloc(sizeof(float)*2*grid.ncells);
+		if(buf->clm_data == NULL || buf->leapval == NULL || buf->qtab == NULL) {
+			fprintf(stderr, "Error allocating memory for clm_data\n");
+			exit(-1);
+		}
+		/* aggregates written by any variable */
+		for(output=0; output<NAGGR; output++) {
+			for(i=0; i<nvar && !(vars[i].aggregates & (1 << output)); i++)
+				;
+			buf->aggr[output] = (i < nvar) ? (float *)malloc(sizeof(float)*aggr_bands[output/NSTATS]*grid.ncells) : NULL;
+			if(i < nvar && buf->aggr[output] == NULL) {
+				fprintf(stderr, "Error allocating memory for aggregates\n");
+				exit(-1);
+			}
+		}
+		if(buf->clm_writedata_short == NULL) {
+			fprintf(stderr, "Error allocating memory for clm_writedata_short\n");
+			exit(-1);
+		}
+	}
+	pthread_mutex_init(&pipe.mutex, NULL);
+	pthread_cond_init(&pipe.cond, NULL);
+	if(opt.metrics != NULL) {
+		fprintf(opt.metrics, "{\n  \"program\": ");
+		write_jsonstring(opt.metrics, argv[0]);
+		fprintf(opt.metrics, ",\n  \"variables\": [\n");
+	}
+	
+	for(i=0; i<nvar; i++) {
+		res.grid_error=res.file_error=res.memory_error = 0;
+		res.fill_error=res.range_error = 0;
+		memset(&res.timing, 0, sizeof(Timing));
+		if(nvar > 1)
+			fprintf(stdout, "\n\t\t>>> variable %d of %d: %s\n", i+1, nvar, vars[i].path_to_outfile);
+		start = wallclock();
+		metrics.size = 0;
+		res.nyear = 0;
+		res.quant_error = 0;
+		convert_variable(&vars[i], &grid, &opt, &pipe, &pool, &res, &metrics);
+		/* results are the same on all ranks */
+		if(mpi_rank == 0)
+			print_result(&res);
+		if(opt.timing && mpi_rank == 0)
+			print_timing(&res.timing);
+		if(opt.metrics != NULL)
+			write_metrics(opt.metrics, &vars[i], &grid, &res, &metrics, wallclock()-start, i == 0);
+		free_metrics(&metrics);
+		/* exit status of first variable with errors */
+		if(status == 0)
+			status = result_status(&res);
+	}
+	if(opt.metrics != NULL) {
+		fprintf(opt.metrics, "\n  ]\n}\n");
+		fclose(opt.metrics);
+	}
+	fprintf(stdout, "\t\t( end of program )\n\n");
+	
+	free_threadpool(&pool);
+	for(buf=pipe.buf; buf<pipe.buf+opt.nbuf; buf++) {
+		free(buf->clm_data);
+		free(buf->clm_writedata_short);
+		free(buf->leapval);
+		free(buf->qtab);
+		for(output=0; output<NAGGR; output++)
+			free(buf->aggr[output]);
+	}
+	free(pipe.buf);
+	pthread_mutex_destroy(&pipe.mutex);
+	pthread_cond_destroy(&pipe.cond);
+	free_grid(&grid);
+	free_variables(vars, nvar);
+#ifdef USE_MPI
+	MPI_Finalize();
+#endif
+	
+	return status;
+}
@@ -0,0 +1,303 @@
+/*
+ * make_testdata.c
+ *
+ *  Writes synthetic daily NetCDF files resembling the ISIMIP climate input
+ *  and a matching LPJmL grid file grid.bin, so that isimip_nc2clm_v2 can be
+ *  benchmarked without the ISIMIP archive (see bench_nc2clm.sh)
+ *  Files are named VAR_FIRSTYEAR_LASTYEAR.nc, hold the variable VAR (float,
+ *  time x lat x lon, _FillValue 1e20 outside of land cells) with latitudes
+ *  from north to south and longitudes from west to east like ISIMIP files.
+ *  Days follow the proleptic gregorian calendar, so leap years are included
+ *  like in ISIMIP data; the range of years sets how many leap years there are
+ *  Use: make_testdata [options] outdir
+ *  -res DEG: resolution in degrees, default 0.5
+ *  -years FIRST LAST: years written, default 2001 2010
+ *  -peryear N: years per file, default 10 like ISIMIP
+ *  -var NAME: variable written, can be repeated, default tas and pr. Values
+ *   resemble the ISIMIP variable of the same name if known
+ *  -land FRACTION: fraction of grid points that are land cells in grid.bin,
+ *   default 0.26 (67,420 cells like the LPJmL grid at 0.5 degree)
+ *  -fill FRACTION: fraction of land values set to the fill value, default 0
+ *  -chunk TIME LAT LON: write NetCDF-4 files with this chunk size
+ *  -deflate LEVEL: write NetCDF-4 files compressed with this deflate level
+ *  -shuffle: write NetCDF-4 files with shuffle filter
+ *  Without -chunk, -deflate and -shuffle files are classic 64 bit offset
+ *  files stored contiguously like ISIMIP files
+ */
+/* compile e.g.:
+ * gcc -O2 make_testdata.c -o make_testdata -lnetcdf -lm
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <netcdf.h>
+
+#define FILL_VALUE 1e20f
+#define MAXVAR 16
+
+typedef struct {
+	int version, order, firstyear, nyear, firstcell, ncell, nband;
+	float cellsize, scalar;
+} Header; // like in isimip_nc2clm_v2.c
+
+typedef struct {
+	double res;
+	int firstyear, lastyear, peryear;
+	int nvar;
+	char *var[MAXVAR];
+	double land, fill;
+	int netcdf4;
+	size_t chunk[3]; // chunk[0] == 0 if not set
+	int deflate, shuffle;
+} Settings;
+
+static void check(int status, const char *what, const char *filename) {
+	if(status != NC_NOERR) {
+		fprintf(stderr, "Error %s %s: %s\n", what, filename, nc_strerror(status));
+		exit(-1);
+	}
+}
+
+static int isleap(int year) {
+	return ((year%4 == 0) && (year%100 != 0)) || (year%400 == 0);
+}
+
+/* deterministic hash of grid point or value so runs are reproducible */
+static unsigned int hash(unsigned int a, unsigned int b, unsigned int c) {
+	unsigned int h = a*0x9e3779b1u ^ (b+0x7f4a7c15u)*0x85ebca6bu ^ (c+0x165667b1u)*0xc2b2ae35u;
+	h ^= h >> 15;
+	h *= 0x2c1b3c6du;
+	h ^= h >> 12;
+	return h;
+}
+
+static double uniform(unsigned int a, unsigned int b, unsigned int c) {
+	return (hash(a, b, c) & 0xffffff)/(double)0x1000000;
+}
+
+static int is_land(const Settings *set, int ilat, int ilon) {
+	return uniform(ilat, ilon, 0) < set->land;
+}
+
+/* value of var at grid point for day of year */
+static float value(const char *var, double lat, int ilat, int ilon, int day, int t) {
+	double season = sin(2*M_PI*(day-105)/365.0)*((lat < 0) ? -1 : 1);
+	double noise = uniform(ilat, ilon, t+1)-0.5;
+	if(strcmp(var, "pr") == 0 || strcmp(var, "prsn") == 0)
+		return (noise > 0.1) ? (float)((noise-0.1)*2e-4) : 0.0f; // kg m-2 s-1
+	if(strcmp(var, "huss") == 0)
+		return (float)(0.001+0.01*cos(lat*M_PI/180)+0.004*season+0.002*noise); // kg kg-1
+	if(strcmp(var, "rsds") == 0)
+		return (float)(150+100*cos(lat*M_PI/180)+80*season+40*noise); // W m-2
+	if(strcmp(var, "rlds") == 0)
+		return (float)(250+100*cos(lat*M_PI/180)+40*season+30*noise); // W m-2
+	if(strcmp(var, "sfcwind") == 0)
+		return (float)(4+2*season+6*noise); // m s-1
+	/* tas, tasmax, tasmin and unknown variables */
+	return (float)(258.15+30*cos(lat*M_PI/180)+10*season+4*noise); // K
+}
+
+static void write_ncfile(const Settings *set, const char *dir, const char *var, int firstyear, int lastyear, int nlat, int nlon) {
+	char filename[4096], units[64];
+	int ncid, dim_id[3], time_id, lat_id, lon_id, var_id, status;
+	int year, day, ndays, ilat, ilon;
+	size_t t, start[3], count[3];
+	double *lat, *lon, *time;
+	float fill = FILL_VALUE, *field;
+
+	snprintf(filename, sizeof(filename), "%s/%s_%d_%d.nc", dir, var, firstyear, lastyear);
+	lat = (double *)malloc(sizeof(double)*nlat);
+	lon = (double *)malloc(sizeof(double)*nlon);
+	field = (float *)malloc(sizeof(float)*nlat*nlon);
+	if(lat == NULL || lon == NULL || field == NULL) {
+		fprintf(stderr, "Error allocating memory for field\n");
+		exit(-1);
+	}
+	for(ilat=0; ilat<nlat; ilat++)
+		lat[ilat] = 90-set->res/2-ilat*set->res;
+	for(ilon=0; ilon<nlon; ilon++)
+		lon[ilon] = -180+set->res/2+ilon*set->res;
+	for(ndays=0, year=firstyear; year<=lastyear; year++)
+		ndays += isleap(year) ? 366 : 365;
+
+	check(nc_create(filename, NC_CLOBBER | (set->netcdf4 ? NC_NETCDF4 : NC_64BIT_OFFSET), &ncid), "creating", filename);
+	status = nc_def_dim(ncid, "time", NC_UNLIMITED, &dim_id[0]);
+	if(status == NC_NOERR)
+		status = nc_def_dim(ncid, "lat", nlat, &dim_id[1]);
+	if(status == NC_NOERR)
+		status = nc_def_dim(ncid, "lon", nlon, &dim_id[2]);
+	if(status == NC_NOERR)
+		status = nc_def_var(ncid, "time", NC_DOUBLE, 1, &dim_id[0], &time_id);
+	if(status == NC_NOERR)
+		status = nc_def_var(ncid, "lat", NC_DOUBLE, 1, &dim_id[1], &lat_id);
+	if(status == NC_NOERR)
+		status = nc_def_var(ncid, "lon", NC_DOUBLE, 1, &dim_id[2], &lon_id);
+	if(status == NC_NOERR)
+		status = nc_def_var(ncid, var, NC_FLOAT, 3, dim_id, &var_id);
+	check(status, "defining variables of", filename);
+	snprintf(units, sizeof(units), "days since %d-01-01 00:00:00", firstyear);
+	status = nc_put_att_text(ncid, time_id, "units", strlen(units), units);
+	if(status == NC_NOERR)
+		status = nc_put_att_text(ncid, time_id, "calendar", strlen("proleptic_gregorian"), "proleptic_gregorian");
+	if(status == NC_NOERR)
+		status = nc_put_att_text(ncid, lat_id, "units", strlen("degrees_north"), "degrees_north");
+	if(status == NC_NOERR)
+		status = nc_put_att_text(ncid, lon_id, "units", strlen("degrees_east"), "degrees_east");
+	if(status == NC_NOERR)
+		status = nc_put_att_float(ncid, var_id, "_FillValue", NC_FLOAT, 1, &fill);
+	if(status == NC_NOERR)
+		status = nc_put_att_float(ncid, var_id, "missing_value", NC_FLOAT, 1, &fill);
+	if(status == NC_NOERR)
+		status = nc_put_att_text(ncid, NC_GLOBAL, "comment", strlen("synthetic data written by make_testdata"), "synthetic data written by make_testdata");
+	check(status, "writing attributes of", filename);
+	if(set->chunk[0] > 0)
+		check(nc_def_var_chunking(ncid, var_id, NC_CHUNKED, set->chunk), "setting chunking of", filename);
+	if(set->deflate > 0 || set->shuffle)
+		check(nc_def_var_deflate(ncid, var_id, set->shuffle, set->deflate > 0, set->deflate), "setting compression of", filename);
+	check(nc_enddef(ncid), "ending definitions of", filename);
+	check(nc_put_var_double(ncid, lat_id, lat), "writing latitudes of", filename);
+	check(nc_put_var_double(ncid, lon_id, lon), "writing longitudes of", filename);
+
+	/* one day at a time */
+	count[0] = 1;
+	count[1] = nlat;
+	count[2] = nlon;
+	start[1] = start[2] = 0;
+	for(t=0, year=firstyear; year<=lastyear; year++) {
+		for(day=0; day<(isleap(year) ? 366 : 365); day++, t++) {
+			for(ilat=0; ilat<nlat; ilat++)
+				for(ilon=0; ilon<nlon; ilon++) {
+					if(!is_land(set, ilat, ilon) || uniform(ilat, ilon, 0x80000000u+t) < set->fill)
+						field[ilat*nlon+ilon] = FILL_VALUE;
+					else
+						field[ilat*nlon+ilon] = value(var, lat[ilat], ilat, ilon, day, (int)t);
+				}
+			start[0] = t;
+			check(nc_put_vara_float(ncid, var_id, start, count, field), "writing data to", filename);
+			time = (double *)field; // reuse memory of field for time value
+			*time = (double)t;
+			check(nc_put_vara_double(ncid, time_id, start, count, time), "writing time to", filename);
+		}
+	}
+	check(nc_close(ncid), "closing", filename);
+	fprintf(stdout, "%s: %d days\n", filename, ndays);
+	free(lat);
+	free(lon);
+	free(field);
+} // of 'write_ncfile'
+
+/* writes grid file with all land points from north to south, returns number of cells */
+static int write_grid(const Settings *set, const char *dir, int nlat, int nlon) {
+	char filename[4096];
+	FILE *file;
+	Header header;
+	int ilat, ilon;
+	short coord[2];
+
+	snprintf(filename, sizeof(filename), "%s/grid.bin", dir);
+	file = fopen(filename, "wb");
+	if(file == NULL) {
+		fprintf(stderr, "Error creating %s\n", filename);
+		exit(-1);
+	}
+	header.version = 2;
+	header.order = 1;
+	header.firstyear = 0;
+	header.nyear = 1;
+	header.firstcell = 0;
+	header.ncell = 0;
+	header.nband = 2;
+	header.cellsize = (float)set->res;
+	header.scalar = 0.01f;
+	fwrite("LPJGRID", 7, 1, file);
+	fwrite(&header, sizeof(Header), 1, file);
+	for(ilat=0; ilat<nlat; ilat++)
+		for(ilon=0; ilon<nlon; ilon++)
+			if(is_land(set, ilat, ilon)) {
+				coord[0] = (short)lround((-180+set->res/2+ilon*set->res)*100);
+				coord[1] = (short)lround((90-set->res/2-ilat*set->res)*100);
+				fwrite(coord, sizeof(short), 2, file);
+				header.ncell++;
+			}
+	fseek(file, 7, SEEK_SET);
+	fwrite(&header, sizeof(Header), 1, file);
+	if(fclose(file)) {
+		fprintf(stderr, "Error writing %s\n", filename);
+		exit(-1);
+	}
+	fprintf(stdout, "%s: %d cells\n", filename, header.ncell);
+	return header.ncell;
+} // of 'write_grid'
+
+static void usage(const char *progname) {
+	fprintf(stderr, "Use: %s [-res DEG] [-years FIRST LAST] [-peryear N] [-var NAME]... [-land FRACTION] [-fill FRACTION] [-chunk TIME LAT LON] [-deflate LEVEL] [-shuffle] outdir\n", progname);
+	exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+	Settings set;
+	int arg, v, year, nlat, nlon;
+	char *dir = NULL;
+
+	set.res = 0.5;
+	set.firstyear = 2001;
+	set.lastyear = 2010;
+	set.peryear = 10;
+	set.nvar = 0;
+	set.land = 0.26;
+	set.fill = 0;
+	set.netcdf4 = 0;
+	set.chunk[0] = set.chunk[1] = set.chunk[2] = 0;
+	set.deflate = set.shuffle = 0;
+	for(arg=1; arg<argc; arg++) {
+		if(strcmp(argv[arg], "-res") == 0 && arg+1 < argc) {
+			set.res = atof(argv[++arg]);
+		} else if(strcmp(argv[arg], "-years") == 0 && arg+2 < argc) {
+			set.firstyear = atoi(argv[++arg]);
+			set.lastyear = atoi(argv[++arg]);
+		} else if(strcmp(argv[arg], "-peryear") == 0 && arg+1 < argc) {
+			set.peryear = atoi(argv[++arg]);
+		} else if(strcmp(argv[arg], "-var") == 0 && arg+1 < argc && set.nvar < MAXVAR) {
+			set.var[set.nvar++] = argv[++arg];
+		} else if(strcmp(argv[arg], "-land") == 0 && arg+1 < argc) {
+			set.land = atof(argv[++arg]);
+		} else if(strcmp(argv[arg], "-fill") == 0 && arg+1 < argc) {
+			set.fill = atof(argv[++arg]);
+		} else if(strcmp(argv[arg], "-chunk") == 0 && arg+3 < argc) {
+			set.chunk[0] = atol(argv[++arg]);
+			set.chunk[1] = atol(argv[++arg]);
+			set.chunk[2] = atol(argv[++arg]);
+			set.netcdf4 = 1;
+		} else if(strcmp(argv[arg], "-deflate") == 0 && arg+1 < argc) {
+			set.deflate = atoi(argv[++arg]);
+			set.netcdf4 = 1;
+		} else if(strcmp(argv[arg], "-shuffle") == 0) {
+			set.shuffle = 1;
+			set.netcdf4 = 1;
+		} else if(argv[arg][0] != '-' && dir == NULL) {
+			dir = argv[arg];
+		} else
+			usage(argv[0]);
+	}
+	if(dir == NULL || set.peryear < 1 || set.lastyear < set.firstyear || set.deflate < 0 || set.deflate > 9)
+		usage(argv[0]);
+	/* grid file stores coordinates in units of 0.01 degree */
+	if(set.res <= 0 || set.res > 90 || fabs(set.res*50-lround(set.res*50)) > 1e-6) {
+		fprintf(stderr, "Invalid resolution %g, must be a multiple of 0.02 degree\n", set.res);
+		return -1;
+	}
+	if(set.nvar == 0) {
+		set.var[set.nvar++] = "tas";
+		set.var[set.nvar++] = "pr";
+	}
+	nlat = (int)lround(180/set.res);
+	nlon = (int)lround(360/set.res);
+
+	write_grid(&set, dir, nlat, nlon);
+	for(v=0; v<set.nvar; v++)
+		for(year=set.firstyear; year<=set.lastyear; year+=set.peryear)
+			write_ncfile(&set, dir, set.var[v], year, (year+set.peryear-1 < set.lastyear) ? year+set.peryear-1 : set.lastyear, nlat, nlon);
+	return 0;
+}
@@ -0,0 +1,329 @@
+/*
+ * nc2clm_kernels.h
+ *
+ *  Inner kernels of isimip_nc2clm_v2 shared with the microbenchmark
+ *  bench_kernels.c
+ *  The gather kernels copy the values of a block of cells from the day-major
+ *  layout read from NetCDF (see 'Readplan' in isimip_nc2clm_v2.c) into a
+ *  cell-major tile with one row of outstride values per cell, starting with
+ *  day firstday of nc_data
+ *  The conversion kernels apply offset and conversion factor to one row of
+ *  values, detect fill values, NaN and values outside the short range, round
+ *  to short and track the data range in one pass. AVX2 and SSE4.1 versions
+ *  are selected at runtime and give results identical to the portable one
+ */
+#ifndef NC2CLM_KERNELS_H
+#define NC2CLM_KERNELS_H
+
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNELS_X86
+#include <immintrin.h>
+#endif
+
+/* size of tiles of the blocked gather: GATHER_CELLS*366 floats (~94 kB) are
+ * written per block, each day row of nc_data is visited once per block */
+#ifndef GATHER_CELLS
+#define GATHER_CELLS 64
+#endif
+#ifndef GATHER_DAYS
+#define GATHER_DAYS 16
+#endif
+
+/* reference gather: all days of one cell after the other, each load is
+ * one day (a whole NetCDF field) apart from the previous one */
+static inline void gather_naive(const float *nc_data, const size_t *nc_base, const size_t *nc_stride, int firstcell, int ncell, int firstday, int ndays, float *tile, int outstride) {
+	int cell, day;
+	for(cell=0; cell<ncell; cell++)
+		for(day=0; day<ndays; day++)
+			tile[(size_t)cell*outstride+day] = nc_data[nc_base[firstcell+cell] + (size_t)(firstday+day)*nc_stride[firstcell+cell]];
+} // of 'gather_naive'
+
+/* blocked gather: tiles of cells x GATHER_DAYS days, the cells of one day
+ * are neighbours in nc_data for spatially ordered grids and the
+ * ncell*GATHER_DAYS destination values stay in cache */
+static inline void gather_blocked(const float *nc_data, const size_t *nc_base, const size_t *nc_stride, int firstcell, int ncell, int firstday, int ndays, float *tile, int outstride) {
+	int cell, day, day0, day1;
+	const size_t *base = nc_base+firstcell, *stride = nc_stride+firstcell;
+	for(day0=0; day0<ndays; day0+=GATHER_DAYS) {
+		day1 = (day0+GATHER_DAYS < ndays) ? day0+GATHER_DAYS : ndays;
+		for(day=day0; day<day1; day++)
+			for(cell=0; cell<ncell; cell++)
+				tile[(size_t)cell*outstride+day] = nc_data[base[cell] + (size_t)(firstday+day)*stride[cell]];
+	}
+} // of 'gather_blocked'
+
+typedef void (*Gatherfunc)(const float *, const size_t *, const size_t *, int, int, int, int, float *, int);
+
+/* gather for the order of the cells: for cells ordered like the grid points
+ * of nc_data (at most one step back per block of cells on average) the naive
+ * gather reads each field forward and is faster than the blocked one, which
+ * only pays off for cells in random order */
+static inline Gatherfunc select_gather(const size_t *nc_base, int ncells) {
+	int cell, nback = 0;
+	for(cell=1; cell<ncells; cell++)
+		if(nc_base[cell] < nc_base[cell-1])
+			nback++;
+	return ((long)nback*GATHER_CELLS <= ncells) ? gather_naive : gather_blocked;
+} // of 'select_gather'
+
+// ***** conversion of rows of values *****
+typedef struct {
+	float offset, convert, fill_value;
+	float threshold; // smallest float not less than 0.0001, see init_kernelparam
+} Kernelparam;
+
+typedef struct {
+	long int nerror; // number of fill values, NaN and values out of range found
+	float min, max; // data range of converted values
+} Kernelstats;
+
+/* convert: out = (in+offset)*convert for n values, counts errors; if finish
+ * is set, also rounds to outshort and updates min and max.
+ * finish: rounds n values of in to outshort and updates min and max.
+ * Variants are selected once per variable by output type (short output
+ * rounds to outshort and counts values out of range, float output ignores
+ * outshort) and whether fill values and NaN are counted */
+typedef void (*Convertfunc)(const float *in, int n, const Kernelparam *p, int finish, float *out, short *outshort, Kernelstats *st);
+typedef void (*Finishfunc)(const float *in, int n, short *outshort, Kernelstats *st);
+
+typedef struct {
+	const char *name;
+	Convertfunc convert[2][2]; // [checkfill][shortout]
+	Finishfunc finish[2]; // [shortout]
+} Kernels;
+
+#ifdef __GNUC__
+#define KERNEL_BODY static inline __attribute__((always_inline))
+#else
+#define KERNEL_BODY static inline
+#endif
+
+static inline void init_kernelparam(Kernelparam *p, float offset, float convert, float fill_value) {
+	p->offset = offset;
+	p->convert = convert;
+	p->fill_value = fill_value;
+	/* fabs(a-b) < 0.0001 of is_equal compares the float difference as double */
+	p->threshold = (float)0.0001;
+	if((double)p->threshold < 0.0001)
+		p->threshold = nextafterf(p->threshold, 1.0f);
+} // of 'init_kernelparam'
+
+/* the first of equal minima or maxima is kept like in a sequential loop,
+ * only 0.0 and -0.0 compare equal with different bits */
+static inline float first_equal(const float *values, int n, float value) {
+	int i;
+	if(value != 0.0f)
+		return value;
+	for(i=0; i<n; i++)
+		if(values[i] == value)
+			return values[i];
+	return value;
+}
+
+KERNEL_BODY void finish_scalar(const float *in, int n, short *outshort, Kernelstats *st, int shortout) {
+	int i;
+	for(i=0; i<n; i++) {
+		if(shortout)
+			outshort[i] = (short)roundf(in[i]);
+		if(in[i] < st->min)
+			st->min = in[i];
+		if(in[i] > st->max)
+			st->max = in[i];
+	}
+} // of 'finish_scalar'
+
+KERNEL_BODY void convert_scalar(const float *in, int n, const Kernelparam *p, int finish, float *out, short *outshort, Kernelstats *st, int checkfill, int shortout) {
+	int i, fill;
+	float value;
+	for(i=0; i<n; i++) {
+		value = (in[i] + p->offset)*p->convert;
+		out[i] = value;
+		fill = fabs(in[i] - p->fill_value) < 0.0001;
+		if(checkfill && (fill || isnan(in[i])))
+			st->nerror++;
+		else if(shortout && !fill && (value < SHRT_MIN || value > SHRT_MAX))
+			st->nerror++;
+	}
+	if(finish)
+		finish_scalar(out, n, outshort, st, shortout);
+} // of 'convert_scalar'
+
+#ifdef KERNELS_X86
+/* roundf() for vectors: truncate and add copysign(1,x) if fraction >= 0.5;
+ * conversion to int and truncation to 16 bits like (short)roundf(x) on x86 */
+__attribute__((target("sse4.1")))
+KERNEL_BODY __m128i round_short_sse(__m128 x) {
+	const __m128 sign = _mm_set1_ps(-0.0f), half = _mm_set1_ps(0.5f), one = _mm_set1_ps(1.0f);
+	__m128 t = _mm_round_ps(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+	__m128 up = _mm_cmpge_ps(_mm_andnot_ps(sign, _mm_sub_ps(x, t)), half);
+	t = _mm_add_ps(t, _mm_and_ps(up, _mm_or_ps(_mm_and_ps(x, sign), one)));
+	return _mm_and_si128(_mm_cvttps_epi32(t), _mm_set1_epi32(0xffff));
+}
+
+__attribute__((target("sse4.1")))
+KERNEL_BODY void finish_sse(const float *in, int n, short *outshort, Kernelstats *st, int shortout) {
+	int i, k;
+	float lanes[4], min, max;
+	__m128 x, x2, vmin = _mm_set1_ps(INFINITY), vmax = _mm_set1_ps(-INFINITY);
+	for(i=0; i+8<=n; i+=8) {
+		x = _mm_loadu_ps(in+i);
+		x2 = _mm_loadu_ps(in+i+4);
+		vmin = _mm_min_ps(x, vmin);
+		vmax = _mm_max_ps(x, vmax);
+		vmin = _mm_min_ps(x2, vmin);
+		vmax = _mm_max_ps(x2, vmax);
+		if(shortout)
+			_mm_storeu_si128((__m128i *)(outshort+i), _mm_packus_epi32(round_short_sse(x), round_short_sse(x2)));
+	}
+	_mm_storeu_ps(lanes, vmin);
+	for(min=lanes[0], k=1; k<4; k++)
+		if(lanes[k] < min)
+			min = lanes[k];
+	_mm_storeu_ps(lanes, vmax);
+	for(max=lanes[0], k=1; k<4; k++)
+		if(lanes[k] > max)
+			max = lanes[k];
+	if(min < st->min)
+		st->min = first_equal(in, i, min);
+	if(max > st->max)
+		st->max = first_equal(in, i, max);
+	finish_scalar(in+i, n-i, shortout ? outshort+i : NULL, st, shortout);
+} // of 'finish_sse'
+
+__attribute__((target("sse4.1")))
+KERNEL_BODY void convert_sse(const float *in, int n, const Kernelparam *p, int finish, float *out, short *outshort, Kernelstats *st, int checkfill, int shortout) {
+	int i;
+	const __m128 offset = _mm_set1_ps(p->offset), convert = _mm_set1_ps(p->convert);
+	const __m128 fill_value = _mm_set1_ps(p->fill_value), threshold = _mm_set1_ps(p->threshold);
+	const __m128 sign = _mm_set1_ps(-0.0f), lo = _mm_set1_ps(SHRT_MIN), hi = _mm_set1_ps(SHRT_MAX);
+	__m128 v, x, fill, error;
+	for(i=0; i+4<=n; i+=4) {
+		v = _mm_loadu_ps(in+i);
+		x = _mm_mul_ps(_mm_add_ps(v, offset), convert);
+		_mm_storeu_ps(out+i, x);
+		if(!checkfill && !shortout)
+			continue;
+		fill = _mm_cmplt_ps(_mm_andnot_ps(sign, _mm_sub_ps(v, fill_value)), threshold);
+		error = checkfill ? _mm_or_ps(fill, _mm_cmpunord_ps(v, v)) : _mm_setzero_ps();
+		if(shortout)
+			error = _mm_or_ps(error, _mm_andnot_ps(fill, _mm_or_ps(_mm_cmplt_ps(x, lo), _mm_cmpgt_ps(x, hi))));
+		st->nerror += __builtin_popcount(_mm_movemask_ps(error));
+	}
+	convert_scalar(in+i, n-i, p, 0, out+i, NULL, st, checkfill, shortout);
+	if(finish)
+		finish_sse(out, n, outshort, st, shortout);
+} // of 'convert_sse'
+
+__attribute__((target("avx2")))
+KERNEL_BODY void finish_avx2(const float *in, int n, short *outshort, Kernelstats *st, int shortout) {
+	int i, k;
+	float lanes[8], min, max;
+	const __m256 sign = _mm256_set1_ps(-0.0f), half = _mm256_set1_ps(0.5f), one = _mm256_set1_ps(1.0f);
+	const __m256i mask = _mm256_set1_epi32(0xffff);
+	__m256 x, t, up, vmin = _mm256_set1_ps(INFINITY), vmax = _mm256_set1_ps(-INFINITY);
+	__m256i r;
+	for(i=0; i+8<=n; i+=8) {
+		x = _mm256_loadu_ps(in+i);
+		vmin = _mm256_min_ps(x, vmin);
+		vmax = _mm256_max_ps(x, vmax);
+		if(shortout) {
+			t = _mm256_round_ps(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+			up = _mm256_cmp_ps(_mm256_andnot_ps(sign, _mm256_sub_ps(x, t)), half, _CMP_GE_OQ);
+			t = _mm256_add_ps(t, _mm256_and_ps(up, _mm256_or_ps(_mm256_and_ps(x, sign), one)));
+			r = _mm256_and_si256(_mm256_cvttps_epi32(t), mask);
+			_mm_storeu_si128((__m128i *)(outshort+i), _mm_packus_epi32(_mm256_castsi256_si128(r), _mm256_extracti128_si256(r, 1)));
+		}
+	}
+	_mm256_storeu_ps(lanes, vmin);
+	for(min=lanes[0], k=1; k<8; k++)
+		if(lanes[k] < min)
+			min = lanes[k];
+	_mm256_storeu_ps(lanes, vmax);
+	for(max=lanes[0], k=1; k<8; k++)
+		if(lanes[k] > max)
+			max = lanes[k];
+	if(min < st->min)
+		st->min = first_equal(in, i, min);
+	if(max > st->max)
+		st->max = first_equal(in, i, max);
+	finish_scalar(in+i, n-i, shortout ? outshort+i : NULL, st, shortout);
+} // of 'finish_avx2'
+
+__attribute__((target("avx2")))
+KERNEL_BODY void convert_avx2(const float *in, int n, const Kernelparam *p, int finish, float *out, short *outshort, Kernelstats *st, int checkfill, int shortout) {
+	int i;
+	const __m256 offset = _mm256_set1_ps(p->offset), convert = _mm256_set1_ps(p->convert);
+	const __m256 fill_value = _mm256_set1_ps(p->fill_value), threshold = _mm256_set1_ps(p->threshold);
+	const __m256 sign = _mm256_set1_ps(-0.0f), lo = _mm256_set1_ps(SHRT_MIN), hi = _mm256_set1_ps(SHRT_MAX);
+	__m256 v, x, fill, error;
+	for(i=0; i+8<=n; i+=8) {
+		v = _mm256_loadu_ps(in+i);
+		x = _mm256_mul_ps(_mm256_add_ps(v, offset), convert);
+		_mm256_storeu_ps(out+i, x);
+		if(!checkfill && !shortout)
+			continue;
+		fill = _mm256_cmp_ps(_mm256_andnot_ps(sign, _mm256_sub_ps(v, fill_value)), threshold, _CMP_LT_OQ);
+		error = checkfill ? _mm256_or_ps(fill, _mm256_cmp_ps(v, v, _CMP_UNORD_Q)) : _mm256_setzero_ps();
+		if(shortout)
+			error = _mm256_or_ps(error, _mm256_andnot_ps(fill, _mm256_or_ps(_mm256_cmp_ps(x, lo, _CMP_LT_OQ), _mm256_cmp_ps(x, hi, _CMP_GT_OQ))));
+		st->nerror += __builtin_popcount(_mm256_movemask_ps(error));
+	}
+	convert_scalar(in+i, n-i, p, 0, out+i, NULL, st, checkfill, shortout);
+	if(finish)
+		finish_avx2(out, n, outshort, st, shortout);
+} // of 'convert_avx2'
+#endif
+
+/* variants of the kernels with constant checkfill and shortout */
+#define KERNEL_VARIANTS(isa, target) \
+	target static void convert_##isa##_00(const float *in, int n, const Kernelparam *p, int finish, float *out, short *outshort, Kernelstats *st) \
+		{ convert_##isa(in, n, p, finish, out, outshort, st, 0, 0); } \
+	target static void convert_##isa##_01(const float *in, int n, const Kernelparam *p, int finish, float *out, short *outshort, Kernelstats *st) \
+		{ convert_##isa(in, n, p, finish, out, outshort, st, 0, 1); } \
+	target static void convert_##isa##_10(const float *in, int n, const Kernelparam *p, int finish, float *out, short *outshort, Kernelstats *st) \
+		{ convert_##isa(in, n, p, finish, out, outshort, st, 1, 0); } \
+	target static void convert_##isa##_11(const float *in, int n, const Kernelparam *p, int finish, float *out, short *outshort, Kernelstats *st) \
+		{ convert_##isa(in, n, p, finish, out, outshort, st, 1, 1); } \
+	target static void finish_##isa##_0(const float *in, int n, short *outshort, Kernelstats *st) \
+		{ finish_##isa(in, n, outshort, st, 0); } \
+	target static void finish_##isa##_1(const float *in, int n, short *outshort, Kernelstats *st) \
+		{ finish_##isa(in, n, outshort, st, 1); }
+#define KERNEL_ENTRY(isa, name) \
+	{name, {{convert_##isa##_00, convert_##isa##_01}, {convert_##isa##_10, convert_##isa##_11}}, {finish_##isa##_0, finish_##isa##_1}}
+
+#ifdef KERNELS_X86
+KERNEL_VARIANTS(avx2, __attribute__((target("avx2"))))
+KERNEL_VARIANTS(sse, __attribute__((target("sse4.1"))))
+#endif
+KERNEL_VARIANTS(scalar, )
+
+static const Kernels kernels[] = {
+#ifdef KERNELS_X86
+	KERNEL_ENTRY(avx2, "avx2"),
+	KERNEL_ENTRY(sse, "sse4.1"),
+#endif
+	KERNEL_ENTRY(scalar, "scalar")
+};
+
+/* returns kernels with given name or best kernels supported by CPU if name is NULL; NULL if not available */
+static inline const Kernels *select_kernels(const char *name) {
+	int i;
+	for(i=0; i<sizeof(kernels)/sizeof(kernels[0]); i++) {
+		if(name != NULL && strcmp(name, kernels[i].name) != 0)
+			continue;
+#ifdef KERNELS_X86
+		if(strcmp(kernels[i].name, "avx2") == 0 && !__builtin_cpu_supports("avx2"))
+			continue;
+		if(strcmp(kernels[i].name, "sse4.1") == 0 && !__builtin_cpu_supports("sse4.1"))
+			continue;
+#endif
+		return &kernels[i];
+	}
+	return NULL;
+} // of 'select_kernels'
+
+#endif